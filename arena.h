@@ -0,0 +1,121 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstdlib>
+#include <vector>
+#include <iostream>
+#include <utility>
+
+/*block_arena class:
+	pool allocator handing out contiguous blocks of B objects, the search
+	trees taking their nodes one at a time as blocks of one. Storage is carved
+	out of large chunks which are kept for the life of the arena, so nothing
+	is given back to the system one node at a time. reset() hands every block back
+	in one step so the same chunks are reused by the next search. Single blocks
+	can also be handed back with free_block(), which keeps them on a free list
+	that alloc_block() takes from first. Objects placed in the arena are never
+	destroyed, so they must not need their destructors run.
+*/
+template <class T, int B>
+class block_arena{
+	private:
+		//number of blocks carved out of each chunk, 16384 objects' worth
+		static const int CHUNK_BLOCKS = 16384 / B;
+		std::vector<T*> chunks;
+		//chunk currently being carved and the next free block within it
+		size_t chunk;
+		int offset;
+		//blocks handed back since the last reset, reused before carving more
+		std::vector<T*> released;
+		//blocks handed out since the last reset, and the most ever handed out
+		size_t used;
+		size_t peak;
+	public:
+		//number of objects in a block
+		static const int BLOCK = B;
+
+		block_arena(){
+			chunk = 0;
+			offset = 0;
+			used = 0;
+			peak = 0;
+		}
+		~block_arena(){
+			for(size_t i = 0; i < chunks.size(); i++)	free(chunks[i]);
+		}
+		//arenas own their chunks, so they cannot be copied
+		block_arena(const block_arena&) = delete;
+		block_arena& operator=(const block_arena&) = delete;
+
+		//returns uninitialized storage for BLOCK contiguous objects
+		T* alloc_block(){
+			if(!released.empty()){
+				T* block = released.back();
+				released.pop_back();
+				used++;
+				if(used > peak)	peak = used;
+				return block;
+			}
+			if(offset == CHUNK_BLOCKS){
+				chunk++;
+				offset = 0;
+			}
+			if(chunk == chunks.size()){
+				//chunks start on a cache line, so over-aligned objects such as child blocks stay aligned
+				T* c = (T*)aligned_alloc(alignof(T) > 64 ? alignof(T) : 64,
+							 sizeof(T) * BLOCK * CHUNK_BLOCKS);
+				if(c == NULL){
+					std::cout<<"ARENA OUT OF MEMORY AFTER "<<used
+						 <<" BLOCKS. EXITING."<<std::endl;
+					exit(0);
+				}
+				chunks.push_back(c);
+			}
+			T* block = chunks[chunk] + (size_t)offset * BLOCK;
+			offset++;
+			used++;
+			if(used > peak)	peak = used;
+			return block;
+		}
+		//hands a block from alloc_block back to be reused by a later alloc_block,
+		//the block's contents being left as they are until then
+		void free_block(T* block){
+			released.push_back(block);
+			used--;
+		}
+		//releases every block at once, keeping the chunks for reuse
+		void reset(){
+			chunk = 0;
+			offset = 0;
+			used = 0;
+			released.clear();
+		}
+		//exchanges storage with another arena, so one arena can be
+		//compacted into another and the two traded places afterwards
+		void swap(block_arena& other){
+			chunks.swap(other.chunks);
+			std::swap(chunk, other.chunk);
+			std::swap(offset, other.offset);
+			released.swap(other.released);
+			std::swap(used, other.used);
+			std::swap(peak, other.peak);
+		}
+		//blocks handed out since the last reset
+		size_t blocks_used() const{
+			return used;
+		}
+		//most blocks that have been in use at once
+		size_t peak_blocks() const{
+			return peak;
+		}
+		//bytes taken by the most blocks that have been in use at once
+		size_t peak_bytes() const{
+			return peak * BLOCK * sizeof(T);
+		}
+		//bytes reserved from the system, in use or not
+		size_t reserved_bytes() const{
+			return chunks.size() * CHUNK_BLOCKS * BLOCK * sizeof(T);
+		}
+};
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstdint>
+#include <immintrin.h>
+#include "puzzlefile.h"
+#include "rng.h"
+
+/*	Batched rollouts:
+	runs many independent random walks from one board at once. The walks are
+	stored side by side, one lane per walk, so that four of them fit in each
+	AVX2 register and every step of the walk is a handful of vector operations.
+	Each lane has its own xoshiro256** generator, also stored side by side and
+	stepped four lanes at a time.
+
+	Every step picks a move uniformly among the legal moves for the lane's empty
+	tile, which is what random_walk gets by rerolling invalid moves, then rolls
+	for its success against the same odds as swap_success. Successful steps add
+	the heuristic of the new board: 1000 at the goal, otherwise 90 minus the
+	manhatten sum, over 160. The integer parts are summed per lane and only turned into
+	a value at the end, so the AVX2 and scalar kernels give identical results.
+*/
+
+//largest number of walks run from one leaf
+#define MAX_BATCH 256
+
+//mean and variance of the values of a batch of walks
+struct rollout_stats{
+	double mean;
+	double variance;
+};
+
+//lookup tables shared by the scalar and vector kernels, widened to 64 bits
+//so that they can be gathered straight into AVX2 lanes
+struct batch_tables{
+	//number of legal moves and the legal moves themselves for each empty index
+	long long legal_count[16];
+	long long legal_move[16 * 4];
+	//index offset of the tile that moves into the empty space for each move
+	long long offset[4];
+	//swap_success odds for each empty index and move
+	long long odds[16 * 4];
+	//manhatten distance of tile v at index i, at v * 16 + i
+	long long distance[16 * 16];
+	constexpr batch_tables() : legal_count(), legal_move(), offset(), odds(), distance(){
+		offset[0] = -4;
+		offset[1] = 4;
+		offset[2] = -1;
+		offset[3] = 1;
+		for(int z = 0; z < 16; z++){
+			legal_count[z] = fifteen_puzzle::lookup.legal_count[z];
+			for(int m = 0; m < 4; m++){
+				odds[z * 4 + m] = fifteen_puzzle::lookup.odds[z][m];
+				legal_move[z * 4 + m] = fifteen_puzzle::lookup.legal[z][m];
+			}
+		}
+		for(int v = 0; v < 16; v++)
+			for(int i = 0; i < 16; i++)
+				distance[v * 16 + i] = fifteen_puzzle::lookup.distance[v][i];
+	}
+};
+constexpr batch_tables batch_lookup;
+
+/*	Batch class:
+	the side by side state of up to MAX_BATCH walks. Lane counts are rounded
+	up to a multiple of four so the vector kernel never needs a remainder loop.
+*/
+class rollout_batch{
+	private:
+		alignas(32) uint64_t board[MAX_BATCH];
+		alignas(32) uint64_t zero[MAX_BATCH];
+		alignas(32) uint64_t distance[MAX_BATCH];
+		//sum of (90 - manhatten sum) over a lane's successful steps,
+		//and the number of those steps that landed on the goal
+		alignas(32) uint64_t score[MAX_BATCH];
+		alignas(32) uint64_t goals[MAX_BATCH];
+		//each lane's generator state, word by word
+		alignas(32) uint64_t s0[MAX_BATCH];
+		alignas(32) uint64_t s1[MAX_BATCH];
+		alignas(32) uint64_t s2[MAX_BATCH];
+		alignas(32) uint64_t s3[MAX_BATCH];
+		int lanes;
+
+		static uint64_t rotl(uint64_t x, int k){
+			return (x << k) | (x >> (64 - k));
+		}
+		//scalar kernel, a step for step copy of the vector kernel below
+		void run_scalar(int steps){
+			for(int l = 0; l < lanes; l++){
+				for(int step = 0; step < steps; step++){
+					uint64_t r = rotl(s1[l] * 5, 7) * 9;
+					uint64_t t = s1[l] << 17;
+					s2[l] ^= s0[l];
+					s3[l] ^= s1[l];
+					s1[l] ^= s2[l];
+					s0[l] ^= s3[l];
+					s2[l] ^= t;
+					s3[l] = rotl(s3[l], 45);
+
+					uint64_t z = zero[l];
+					uint64_t pick = ((r & 0xFFFFFFFFULL) * batch_lookup.legal_count[z]) >> 32;
+					uint64_t move = batch_lookup.legal_move[z * 4 + pick];
+					uint64_t roll = (((r >> 32) * 100) >> 32) + 1;
+					if((long long)roll < batch_lookup.odds[z * 4 + move])	continue;
+					uint64_t next = z + batch_lookup.offset[move];
+					uint64_t tile = (board[l] >> (next << 2)) & 0xF;
+					board[l] ^= (tile << (next << 2)) ^ (tile << (z << 2));
+					distance[l] += batch_lookup.distance[tile * 16 + z]
+						     - batch_lookup.distance[tile * 16 + next];
+					zero[l] = next;
+					if(board[l] == goal_board)	goals[l]++;
+					else				score[l] += 90 - distance[l];
+				}
+			}
+		}
+		//AVX2 kernel, four lanes per register, each group of four lanes kept
+		//in registers for the whole walk
+		__attribute__((target("avx2")))
+		void run_avx2(int steps){
+			const long long* legal_count = batch_lookup.legal_count;
+			const long long* legal_move = batch_lookup.legal_move;
+			const long long* offset = batch_lookup.offset;
+			const long long* odds = batch_lookup.odds;
+			const long long* table = batch_lookup.distance;
+			const __m256i low = _mm256_set1_epi64x(0xFFFFFFFFLL);
+			const __m256i nibble = _mm256_set1_epi64x(0xF);
+			const __m256i hundred = _mm256_set1_epi64x(100);
+			const __m256i one = _mm256_set1_epi64x(1);
+			const __m256i ninety = _mm256_set1_epi64x(90);
+			const __m256i goal = _mm256_set1_epi64x((long long)goal_board);
+			for(int l = 0; l < lanes; l += 4){
+				__m256i b = _mm256_load_si256((const __m256i*)&board[l]);
+				__m256i z = _mm256_load_si256((const __m256i*)&zero[l]);
+				__m256i d = _mm256_load_si256((const __m256i*)&distance[l]);
+				__m256i sc = _mm256_load_si256((const __m256i*)&score[l]);
+				__m256i g = _mm256_load_si256((const __m256i*)&goals[l]);
+				__m256i r0 = _mm256_load_si256((const __m256i*)&s0[l]);
+				__m256i r1 = _mm256_load_si256((const __m256i*)&s1[l]);
+				__m256i r2 = _mm256_load_si256((const __m256i*)&s2[l]);
+				__m256i r3 = _mm256_load_si256((const __m256i*)&s3[l]);
+				for(int step = 0; step < steps; step++){
+					//xoshiro256**, with the multiplies by 5 and 9 done as shifts and adds
+					__m256i x = _mm256_add_epi64(_mm256_slli_epi64(r1, 2), r1);
+					x = _mm256_or_si256(_mm256_slli_epi64(x, 7), _mm256_srli_epi64(x, 57));
+					__m256i r = _mm256_add_epi64(_mm256_slli_epi64(x, 3), x);
+					__m256i t = _mm256_slli_epi64(r1, 17);
+					r2 = _mm256_xor_si256(r2, r0);
+					r3 = _mm256_xor_si256(r3, r1);
+					r1 = _mm256_xor_si256(r1, r2);
+					r0 = _mm256_xor_si256(r0, r3);
+					r2 = _mm256_xor_si256(r2, t);
+					r3 = _mm256_or_si256(_mm256_slli_epi64(r3, 45), _mm256_srli_epi64(r3, 19));
+
+					//picking a legal move with the low half of the random bits
+					__m256i count = _mm256_i64gather_epi64(legal_count, z, 8);
+					__m256i pick = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_and_si256(r, low), count), 32);
+					__m256i slot = _mm256_add_epi64(_mm256_slli_epi64(z, 2), pick);
+					__m256i move = _mm256_i64gather_epi64(legal_move, slot, 8);
+					//rolling for success with the high half
+					__m256i roll = _mm256_add_epi64(_mm256_srli_epi64(
+						_mm256_mul_epu32(_mm256_srli_epi64(r, 32), hundred), 32), one);
+					__m256i slot_odds = _mm256_add_epi64(_mm256_slli_epi64(z, 2), move);
+					__m256i fail = _mm256_cmpgt_epi64(_mm256_i64gather_epi64(odds, slot_odds, 8), roll);
+
+					//sliding the tile into the empty space
+					__m256i next = _mm256_add_epi64(z, _mm256_i64gather_epi64(offset, move, 8));
+					__m256i next_shift = _mm256_slli_epi64(next, 2);
+					__m256i tile = _mm256_and_si256(_mm256_srlv_epi64(b, next_shift), nibble);
+					__m256i moved = _mm256_xor_si256(b, _mm256_xor_si256(
+						_mm256_sllv_epi64(tile, next_shift),
+						_mm256_sllv_epi64(tile, _mm256_slli_epi64(z, 2))));
+					__m256i row = _mm256_slli_epi64(tile, 4);
+					__m256i moved_d = _mm256_sub_epi64(_mm256_add_epi64(d,
+						_mm256_i64gather_epi64(table, _mm256_add_epi64(row, z), 8)),
+						_mm256_i64gather_epi64(table, _mm256_add_epi64(row, next), 8));
+
+					//keeping the old lane wherever the move failed
+					b = _mm256_blendv_epi8(moved, b, fail);
+					z = _mm256_blendv_epi8(next, z, fail);
+					d = _mm256_blendv_epi8(moved_d, d, fail);
+					//successful lanes score their new board, the goal counted separately
+					__m256i at_goal = _mm256_cmpeq_epi64(b, goal);
+					__m256i gain = _mm256_andnot_si256(_mm256_or_si256(fail, at_goal),
+						_mm256_sub_epi64(ninety, d));
+					sc = _mm256_add_epi64(sc, gain);
+					g = _mm256_sub_epi64(g, _mm256_andnot_si256(fail, at_goal));
+				}
+				_mm256_store_si256((__m256i*)&board[l], b);
+				_mm256_store_si256((__m256i*)&zero[l], z);
+				_mm256_store_si256((__m256i*)&distance[l], d);
+				_mm256_store_si256((__m256i*)&score[l], sc);
+				_mm256_store_si256((__m256i*)&goals[l], g);
+				_mm256_store_si256((__m256i*)&s0[l], r0);
+				_mm256_store_si256((__m256i*)&s1[l], r1);
+				_mm256_store_si256((__m256i*)&s2[l], r2);
+				_mm256_store_si256((__m256i*)&s3[l], r3);
+			}
+		}
+	public:
+		//whether the vector kernel can run on this machine
+		static bool has_avx2(){
+			static const bool result = __builtin_cpu_supports("avx2");
+			return result;
+		}
+
+		/*runs count walks of iterations + 1 steps each from the start board,
+		  the same number of steps random_walk takes, seeding every lane from
+		  the search's generator. Returns the mean and sample variance of the
+		  walks' summed values.*/
+		rollout_stats walk(int iterations, const fifteen_puzzle& start, int count,
+				   xoshiro256& rng, bool vector = true){
+			if(count < 1)	count = 1;
+			if(count > MAX_BATCH)	count = MAX_BATCH;
+			lanes = (count + 3) & ~3;
+			for(int l = 0; l < lanes; l++){
+				board[l] = start.packed();
+				zero[l] = start.blank();
+				distance[l] = start.manhatten();
+				score[l] = 0;
+				goals[l] = 0;
+				xoshiro256 lane(rng.next());
+				s0[l] = lane.next();
+				s1[l] = lane.next();
+				s2[l] = lane.next();
+				s3[l] = lane.next();
+			}
+			if(vector && has_avx2())	run_avx2(iterations + 1);
+			else				run_scalar(iterations + 1);
+			//only the first count lanes are used, the rest were padding
+			double total = 0;
+			double squares = 0;
+			for(int l = 0; l < count; l++){
+				double value = score[l] / 160.0 + 1000.0 * goals[l];
+				total += value;
+				squares += value * value;
+			}
+			rollout_stats result;
+			result.mean = total / count;
+			result.variance = count > 1 ? (squares - total * result.mean) / (count - 1) : 0;
+			if(result.variance < 0)	result.variance = 0;
+			return result;
+		}
+};
+
+#endif
@@ -0,0 +1,367 @@
+/*	bench.cpp
+	Benchmarks for the fifteen puzzle solver, built with make bench and run as
+	./bench [heuristic] [micro] [rollout] [e2e] [policy] [--pdb PATH], every
+	part being run when none is named. With --pdb, the rollout and end to end parts also
+	run with walks scored by the pattern databases in PATH.
+
+	Heuristic throughput:
+		scores the same set of random boards three ways and reports boards
+		per second for each, after checking that all three agree exactly with
+		fifteen_puzzle::heuristic():
+			divmod	the original per tile division and modulo formula
+			lookup	the scalar manhatten lookup path
+			batch	batch_heuristic, vectorized when AVX2 is available
+
+	Micro benchmarks:
+		nanoseconds per call of heuristic(), swap(), valid_swap(), random_walk(),
+		Node::expand(), a single mcts() iteration on a growing tree, and one
+		level of selection descending a deep tree.
+
+	Rollout estimators:
+		mean, variance and time per walk of random_walk and expected_walk
+		from the same board, whose means should agree, and of random_walk
+		scored by the pattern databases.
+
+	End to end:
+		solves a fixed corpus of seeded scrambles with the default search
+		settings, once with sampled and once with expected value walks, and
+		once with sampled walks scored by the pattern databases, reporting
+		moves to solve, wall time and iterations per second for each board
+		and over the whole corpus.
+
+	Rollout policies:
+		walks per second from one board with each rollout policy, then the
+		end to end corpus solved with each, the moves to solve standing for
+		the quality of the decisions the policy's walks lead to.
+*/
+
+#include "mcts.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+
+#define BENCH_BOARDS (1 << 16)
+#define BENCH_ROUNDS 64
+#define BENCH_CALLS (1 << 22)
+#define BENCH_WALKS (1 << 14)
+#define BENCH_ITERATIONS 2000
+#define BENCH_TREES 10
+//iterations grown before timing selection, and the iterations timed
+#define BENCH_DEEP_ITERATIONS 20000
+#define BENCH_TIMED_ITERATIONS 2000
+//scrambles in the end to end corpus, their depths, and the move limit per game
+#define CORPUS_BOARDS 12
+#define CORPUS_MIN_DEPTH 3
+#define CORPUS_MAX_DEPTH 8
+#define CORPUS_MAX_MOVES 1000
+
+//pattern databases given with --pdb, left empty otherwise
+pattern_database bench_pdb;
+
+//the original heuristic, recomputing every tile with division and modulo
+double divmod_heuristic(uint64_t board){
+	if(board == goal_board)	return 1000;
+	double value = 0;
+	for(int i = 0; i < 16; i++){
+		int v = (board >> (i << 2)) & 0xF;
+		if(v == 0)	continue;
+		int column_difference = (i % 4 > (v - 1) % 4)
+				      ? i % 4 - (v - 1) % 4
+				      : (v - 1) % 4 - i % 4;
+		int row_difference = (i / 4 > (v - 1) / 4)
+				   ? i / 4 - (v - 1) / 4
+				   : (v - 1) / 4 - i / 4;
+		value += (6.0 - (row_difference + column_difference));
+	}
+	return value / 160;
+}
+
+//fills boards with random permutations of the sixteen tiles, returning the puzzles
+vector<fifteen_puzzle> random_boards(int n, xoshiro256& rng){
+	vector<fifteen_puzzle> result;
+	int tiles[16];
+	for(int k = 0; k < n; k++){
+		for(int i = 0; i < 16; i++)	tiles[i] = i;
+		for(int i = 15; i > 0; i--){
+			int r = rng.below(i + 1);
+			int temp = tiles[i];
+			tiles[i] = tiles[r];
+			tiles[r] = temp;
+		}
+		result.push_back(fifteen_puzzle(tiles));
+	}
+	//making sure the goal is scored too
+	int goal[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0};
+	result[0] = fifteen_puzzle(goal);
+	return result;
+}
+
+double seconds_since(chrono::steady_clock::time_point start){
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void bench_heuristic(){
+	xoshiro256 rng(1);
+	vector<fifteen_puzzle> puzzles = random_boards(BENCH_BOARDS, rng);
+	vector<uint64_t> boards(BENCH_BOARDS);
+	vector<double> expected(BENCH_BOARDS), values(BENCH_BOARDS);
+	for(int i = 0; i < BENCH_BOARDS; i++){
+		boards[i] = puzzles[i].packed();
+		expected[i] = puzzles[i].heuristic();
+	}
+
+	//checking every path against heuristic()
+	int mismatches = 0;
+	batch_heuristic(boards.data(), BENCH_BOARDS, values.data());
+	for(int i = 0; i < BENCH_BOARDS; i++){
+		if(values[i] != expected[i])	mismatches++;
+		if(packed_heuristic(boards[i]) != expected[i])	mismatches++;
+		if(divmod_heuristic(boards[i]) != expected[i])	mismatches++;
+	}
+	cout<<"heuristic mismatches: "<<mismatches<<endl;
+
+	double sink = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		for(int i = 0; i < BENCH_BOARDS; i++)	sink += divmod_heuristic(boards[i]);
+	double divmod = seconds_since(start);
+
+	start = chrono::steady_clock::now();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		for(int i = 0; i < BENCH_BOARDS; i++)	sink += packed_heuristic(boards[i]);
+	double lookup = seconds_since(start);
+
+	start = chrono::steady_clock::now();
+	for(int r = 0; r < BENCH_ROUNDS; r++){
+		batch_heuristic(boards.data(), BENCH_BOARDS, values.data());
+		sink += values[r];
+	}
+	double batch = seconds_since(start);
+
+	double n = (double)BENCH_BOARDS * BENCH_ROUNDS;
+	cout<<"heuristic divmod: "<<n / divmod<<" boards/s"<<endl;
+	cout<<"heuristic lookup: "<<n / lookup<<" boards/s"<<endl;
+	cout<<"heuristic batch:  "<<n / batch<<" boards/s"<<endl;
+	//keeping the loops from being optimized away
+	if(sink == 0)	cout<<endl;
+}
+
+//prints the time per call of a micro benchmark
+void report(const char* name, double seconds, double calls){
+	cout<<name<<": "<<seconds * 1e9 / calls<<" ns"<<endl;
+}
+
+//a board some distance from the goal, made by playing random moves from the
+//goal until depth of them have succeeded, never undoing the move before
+fifteen_puzzle scramble(int depth, xoshiro256& rng){
+	int goal[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0};
+	fifteen_puzzle p(goal);
+	const int opposite[4] = {1, 0, 3, 2};
+	int last = -1;
+	for(int i = 0; i < depth; i++){
+		int move = rng.below(4);
+		while(!p.valid_swap(map[move]) || (last >= 0 && move == opposite[last]))
+			move = rng.below(4);
+		while(!p.swap(map[move], rng));
+		last = move;
+	}
+	return p;
+}
+
+void bench_micro(){
+	xoshiro256 rng(2);
+	vector<fifteen_puzzle> puzzles = random_boards(BENCH_BOARDS, rng);
+	double sink = 0;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(int i = 0; i < BENCH_CALLS; i++)	sink += puzzles[i & (BENCH_BOARDS - 1)].heuristic();
+	report("heuristic()", seconds_since(start), BENCH_CALLS);
+
+	start = chrono::steady_clock::now();
+	for(int i = 0; i < BENCH_CALLS; i++)
+		sink += puzzles[i & (BENCH_BOARDS - 1)].valid_swap(map[i & 3]);
+	report("valid_swap()", seconds_since(start), BENCH_CALLS);
+
+	//sliding the empty tile right and back from index 5, always a valid move
+	int tiles[16] = {1, 2, 3, 4, 5, 0, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+	fifteen_puzzle p(tiles);
+	start = chrono::steady_clock::now();
+	for(int i = 0; i < BENCH_CALLS; i++)
+		sink += p.swap(p.blank() == 5 ? 'R' : 'L', rng);
+	report("swap()", seconds_since(start), BENCH_CALLS);
+
+	start = chrono::steady_clock::now();
+	for(int i = 0; i < BENCH_WALKS; i++)
+		sink += random_walk(RANDOM_WALK_ITERATIONS, puzzles[i & (BENCH_BOARDS - 1)], rng);
+	report("random_walk()", seconds_since(start), BENCH_WALKS);
+
+	search_options options;
+	search_context<fifteen_puzzle> ctx(3, options);
+	start = chrono::steady_clock::now();
+	for(int i = 0; i < BENCH_CALLS / 16; i++){
+		//the arena is emptied now and then, the nodes expanded so far being dropped
+		if((i & 4095) == 0)	ctx.arena.reset();
+		Node<fifteen_puzzle> n(puzzles[i & (BENCH_BOARDS - 1)]);
+		sink += n.expand(ctx);
+	}
+	report("Node::expand()", seconds_since(start), BENCH_CALLS / 16);
+
+	//fresh trees of a few thousand iterations each, about what a whole game
+	//grows with the default settings
+	fifteen_puzzle board = scramble(CORPUS_MAX_DEPTH, rng);
+	transposition_table<fifteen_puzzle> table(TABLE_ENTRIES);
+	ctx.table = &table;
+	start = chrono::steady_clock::now();
+	for(int t = 0; t < BENCH_TREES; t++){
+		ctx.arena.reset();
+		table.new_search();
+		Node<fifteen_puzzle> root(board);
+		for(int i = 0; i < BENCH_ITERATIONS; i++){
+			ctx.begin_iteration(i);
+			root.mcts(ctx);
+		}
+	}
+	report("mcts() iteration", seconds_since(start), BENCH_TREES * BENCH_ITERATIONS);
+
+	//selection alone, timed by the search's own phase timers over the
+	//iterations of a tree grown with short walks so that it runs deep, as
+	//the descents of a long search do
+	ctx.arena.reset();
+	table.new_search();
+	ctx.rollout_steps = 10;
+	Node<fifteen_puzzle> deep(board);
+	for(int i = 0; i < BENCH_DEEP_ITERATIONS; i++)	deep.mcts(ctx);
+	ctx.stats = search_stats();
+	for(int i = 0; i < BENCH_TIMED_ITERATIONS; i++)	deep.mcts(ctx);
+	if(ctx.stats.depth_total > 0)
+		report("selection, per level", ctx.stats.select_ns / 1e9, ctx.stats.depth_total);
+	if(sink == 0)	cout<<endl;
+}
+
+void bench_rollout(){
+	xoshiro256 rng(5);
+	fifteen_puzzle board = scramble(CORPUS_MAX_DEPTH, rng);
+	double sink = 0;
+	for(int expected = 0; expected < 2; expected++){
+		double total = 0;
+		double squares = 0;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for(int i = 0; i < BENCH_WALKS; i++){
+			double value = expected ? expected_walk(RANDOM_WALK_ITERATIONS, board, rng)
+						: random_walk(RANDOM_WALK_ITERATIONS, board, rng);
+			value /= RANDOM_WALK_ITERATIONS;
+			total += value;
+			squares += value * value;
+		}
+		double seconds = seconds_since(start);
+		double mean = total / BENCH_WALKS;
+		cout<<(expected ? "expected_walk: " : "random_walk:   ")<<"mean "<<mean
+		    <<", variance "<<(squares - total * mean) / (BENCH_WALKS - 1)
+		    <<", "<<seconds * 1e9 / BENCH_WALKS<<" ns per walk"<<endl;
+	}
+	if(!bench_pdb.loaded())	return;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(int i = 0; i < BENCH_WALKS; i++)
+		sink += random_walk(RANDOM_WALK_ITERATIONS, board, rng, NULL, &bench_pdb);
+	cout<<"pdb random_walk: "<<seconds_since(start) * 1e9 / BENCH_WALKS<<" ns per walk"<<endl;
+	if(sink == 0)	cout<<endl;
+}
+
+//solves the corpus with the given options, labelling the totals
+void bench_corpus(const search_options& options, const char* label){
+	xoshiro256 rng(4);
+	int solved = 0;
+	long long moves = 0;
+	long long iterations = 0;
+	long long rollouts = 0;
+	double seconds = 0;
+	cout<<"board\tdepth\tsolved\tmoves\tms\titerations/s"<<endl;
+	for(int b = 0; b < CORPUS_BOARDS; b++){
+		int depth = CORPUS_MIN_DEPTH + b % (CORPUS_MAX_DEPTH - CORPUS_MIN_DEPTH + 1);
+		fifteen_puzzle start = scramble(depth, rng);
+		solve_result result = solve(start, options, b + 1, CORPUS_MAX_MOVES);
+		cout<<b<<"\t"<<depth<<"\t"<<result.solved<<"\t"<<result.moves<<"\t"
+		    <<result.seconds * 1000<<"\t"<<result.iterations / result.seconds<<endl;
+		solved += result.solved;
+		moves += result.moves;
+		iterations += result.iterations;
+		rollouts += result.rollouts;
+		seconds += result.seconds;
+	}
+	cout<<label<<" corpus: "<<solved<<"/"<<CORPUS_BOARDS<<" solved, "<<moves<<" moves, "
+	    <<seconds * 1000<<" ms, "<<iterations / seconds<<" iterations/s, "
+	    <<rollouts / seconds<<" rollouts/s"<<endl;
+}
+
+void bench_e2e(){
+	search_options options;
+	bench_corpus(options, "sampled");
+	options.expected = true;
+	bench_corpus(options, "expected");
+	if(bench_pdb.loaded()){
+		options.expected = false;
+		options.pdb = &bench_pdb;
+		bench_corpus(options, "pdb sampled");
+	}
+}
+
+//walk throughput from one board and the corpus solved with each rollout policy
+void bench_policy(){
+	xoshiro256 rng(5);
+	fifteen_puzzle board = scramble(CORPUS_MAX_DEPTH, rng);
+	for(int policy = POLICY_RETRY; policy <= POLICY_GREEDY; policy++){
+		search_options options;
+		options.policy = policy;
+		search_context<fifteen_puzzle> ctx(5, options);
+		double total = 0;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for(int i = 0; i < BENCH_WALKS; i++)	total += sampled_walk(ctx, board);
+		double seconds = seconds_since(start);
+		cout<<policy_name(policy)<<" walks: mean "<<total / BENCH_WALKS / RANDOM_WALK_ITERATIONS
+		    <<", "<<BENCH_WALKS / seconds<<" rollouts/s"<<endl;
+	}
+	for(int policy = POLICY_RETRY; policy <= POLICY_GREEDY; policy++){
+		search_options options;
+		options.policy = policy;
+		bench_corpus(options, policy_name(policy));
+	}
+}
+
+int main(int argc, char** argv){
+	bool all = true;
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "--pdb") == 0 && i + 1 < argc){
+			const char* error = bench_pdb.load(argv[++i]);
+			if(error != NULL){
+				cout<<"COULD NOT LOAD PATTERN DATABASE "<<argv[i]<<": "<<error<<endl;
+				return 1;
+			}
+			continue;
+		}
+		if(strcmp(argv[i], "heuristic") != 0 && strcmp(argv[i], "micro") != 0
+		   && strcmp(argv[i], "rollout") != 0 && strcmp(argv[i], "e2e") != 0
+		   && strcmp(argv[i], "policy") != 0){
+			cout<<"usage: "<<argv[0]<<" [heuristic] [micro] [rollout] [e2e] [policy] [--pdb PATH]"<<endl;
+			return 1;
+		}
+		all = false;
+	}
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "heuristic") == 0)	bench_heuristic();
+		if(strcmp(argv[i], "micro") == 0)	bench_micro();
+		if(strcmp(argv[i], "rollout") == 0)	bench_rollout();
+		if(strcmp(argv[i], "e2e") == 0)		bench_e2e();
+		if(strcmp(argv[i], "policy") == 0)	bench_policy();
+	}
+	if(all){
+		bench_heuristic();
+		bench_micro();
+		bench_rollout();
+		bench_e2e();
+		bench_policy();
+	}
+	return 0;
+}
@@ -0,0 +1,286 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "puzzlefile.h"
+
+/*	Position cache:
+	the moves completed searches chose, kept in a file by packed board so that
+	later runs can play a board already decided with confidence without
+	searching it again. The file is a fixed size header followed by a power of
+	two number of 24 byte slots in buckets of four, a board's bucket chosen by
+	its zobrist hash, so the file never grows past the size it was made with.
+	Boards of every puzzle size share one file, a slot recording the size of
+	its board alongside the move.
+
+	A slot's confidence is the visits of the chosen root child and that
+	child's share of the root's visits. A search choosing the same move again
+	leaves the slot with the stronger of the two, and a search choosing another
+	move takes the slot over if it has at least as many visits, or otherwise
+	takes its visits away from the slot's. Visits are not pooled, since a tree
+	kept between moves brings its visits along every time a game passes back
+	through a board. A lookup only counts as a hit when both the visits and the
+	share reach the cache's thresholds.
+
+	Slots are read and written without locks, by any number of threads and
+	processes mapping the same file. Each slot keeps its data word and its
+	board xored with that data word, so a slot caught halfway through being
+	written by someone else no longer matches its board and is read as a miss.
+	Two writers updating one slot at once can lose one of the updates, which
+	only costs a search later. A slot that still matches but holds a move its
+	board cannot make is read as a miss too, so a corrupt file costs searches
+	but never stalls a game on a move that does nothing.
+*/
+
+#define CACHE_VERSION 1
+#define CACHE_MAGIC "MCTSPOS"
+#define CACHE_BUCKET 4
+//slots in a newly made cache file, 24MB worth
+#define CACHE_ENTRIES (1 << 20)
+//confidence a slot needs for a lookup to hit
+#define CACHE_MIN_VISITS 200
+#define CACHE_MIN_SHARE 0.7
+
+struct cache_header{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t slots;
+};
+
+struct cache_slot{
+	//packed board split into two words, each xored with data
+	uint64_t check_low;
+	uint64_t check_high;
+	//move index in bits 0-1, board cells in bits 2-6, share of the root's
+	//visits out of 65535 in bits 7-22 and visits in bits 23-54, 0 if empty
+	uint64_t data;
+};
+
+//what a slot holds once unpacked
+struct cache_entry{
+	int move;
+	int visits;
+	double share;
+};
+
+/*position_cache class:
+	a position cache file mapped read and write into memory, shared by every
+	thread that holds a pointer to it
+*/
+class position_cache{
+	private:
+		void* mapping;
+		size_t bytes;
+		cache_slot* slots;
+		uint64_t mask;
+		int min_visits;
+		double min_share;
+		//counters for this process alone
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+		std::atomic<uint64_t> stores;
+
+		static uint64_t pack(int move, int cells, int visits, double share){
+			uint64_t s = share <= 0 ? 0 : share >= 1 ? 65535 : (uint64_t)(share * 65535 + 0.5);
+			return (uint64_t)move | ((uint64_t)cells << 2) | (s << 7) | ((uint64_t)(uint32_t)visits << 23);
+		}
+		static cache_entry unpack(uint64_t data){
+			cache_entry e;
+			e.move = data & 3;
+			e.share = (double)((data >> 7) & 0xFFFF) / 65535;
+			e.visits = (data >> 23) & 0x7FFFFFFF;
+			return e;
+		}
+		static int cells(uint64_t data){
+			return (data >> 2) & 0x1F;
+		}
+		//the board's two halves, and its bucket
+		template <class P>
+		cache_slot* bucket(const P& p, uint64_t& low, uint64_t& high) const{
+			low = (uint64_t)p.packed();
+			high = (uint64_t)((unsigned __int128)p.packed() >> 64);
+			uint64_t h = p.hash() ^ ((uint64_t)P::CELLS * 0x9E3779B97F4A7C15ULL);
+			return &slots[(h & mask) * CACHE_BUCKET];
+		}
+		//reads a slot's data word if the slot holds the board, 0 otherwise
+		static uint64_t read(const cache_slot& slot, uint64_t low, uint64_t high, int cells){
+			uint64_t data = __atomic_load_n(&slot.data, __ATOMIC_ACQUIRE);
+			uint64_t check_low = __atomic_load_n(&slot.check_low, __ATOMIC_RELAXED);
+			uint64_t check_high = __atomic_load_n(&slot.check_high, __ATOMIC_RELAXED);
+			if(data == 0 || (check_low ^ data) != low || (check_high ^ data) != high
+			   || position_cache::cells(data) != cells)
+				return 0;
+			return data;
+		}
+		static void write(cache_slot& slot, uint64_t low, uint64_t high, uint64_t data){
+			__atomic_store_n(&slot.check_low, low ^ data, __ATOMIC_RELAXED);
+			__atomic_store_n(&slot.check_high, high ^ data, __ATOMIC_RELAXED);
+			__atomic_store_n(&slot.data, data, __ATOMIC_RELEASE);
+		}
+	public:
+		position_cache(){
+			mapping = NULL;
+			bytes = 0;
+			slots = NULL;
+			mask = 0;
+			min_visits = CACHE_MIN_VISITS;
+			min_share = CACHE_MIN_SHARE;
+			hits = misses = stores = 0;
+		}
+		~position_cache(){
+			if(mapping != NULL)	munmap(mapping, bytes);
+		}
+		//caches own their mapping, so they cannot be copied
+		position_cache(const position_cache&) = delete;
+		position_cache& operator=(const position_cache&) = delete;
+
+		//maps the file at path, making it with entries slots, rounded down to
+		//a power of two number of buckets, if it does not exist yet. Returns
+		//NULL on success or what was wrong with the file, in which case the
+		//cache is left empty.
+		const char* load(const char* path, size_t entries = CACHE_ENTRIES){
+			int fd = open(path, O_RDWR | O_CREAT, 0644);
+			if(fd < 0)	return "could not open file";
+			struct stat info;
+			if(fstat(fd, &info) != 0){
+				close(fd);
+				return "could not open file";
+			}
+			bool made = info.st_size == 0;
+			if(made){
+				uint64_t buckets = 1;
+				while(buckets * 2 * CACHE_BUCKET <= entries)	buckets *= 2;
+				info.st_size = sizeof(cache_header) + buckets * CACHE_BUCKET * sizeof(cache_slot);
+				if(ftruncate(fd, info.st_size) != 0){
+					close(fd);
+					return "could not size file";
+				}
+			}
+			else if((size_t)info.st_size < sizeof(cache_header)){
+				close(fd);
+				return "file too short";
+			}
+			void* m = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if(m == MAP_FAILED)	return "could not map file";
+			cache_header* h = (cache_header*)m;
+			if(made){
+				memcpy(h->magic, CACHE_MAGIC, 8);
+				h->version = CACHE_VERSION;
+				h->slots = (info.st_size - sizeof(cache_header)) / sizeof(cache_slot);
+			}
+			const char* error = NULL;
+			if(memcmp(h->magic, CACHE_MAGIC, 8) != 0)	error = "not a position cache";
+			else if(h->version != CACHE_VERSION)	error = "wrong version";
+			else if(h->slots < CACHE_BUCKET || (h->slots & (h->slots - 1)) != 0)	error = "bad slot count";
+			else if(sizeof(cache_header) + h->slots * sizeof(cache_slot) > (uint64_t)info.st_size)
+				error = "file too short";
+			if(error != NULL){
+				munmap(m, info.st_size);
+				return error;
+			}
+			if(mapping != NULL)	munmap(mapping, bytes);
+			mapping = m;
+			bytes = info.st_size;
+			slots = (cache_slot*)(h + 1);
+			mask = h->slots / CACHE_BUCKET - 1;
+			return NULL;
+		}
+		bool loaded() const{
+			return mapping != NULL;
+		}
+		//confidence a slot needs for a lookup to hit
+		void set_confidence(int visits, double share){
+			min_visits = visits;
+			min_share = share;
+		}
+		//looks a board up, returning the cached move index if the board was
+		//decided with enough confidence, -1 otherwise. A move the board cannot
+		//make, from a corrupt slot or a board that only matched by chance,
+		//counts as a miss so that the board is searched instead
+		template <class P>
+		int lookup(const P& p){
+			uint64_t low, high;
+			cache_slot* b = bucket(p, low, high);
+			for(int i = 0; i < CACHE_BUCKET; i++){
+				uint64_t data = read(b[i], low, high, P::CELLS);
+				if(data == 0)	continue;
+				cache_entry e = unpack(data);
+				if(e.visits >= min_visits && e.share >= min_share && p.valid_swap(map[e.move])){
+					hits.fetch_add(1, std::memory_order_relaxed);
+					return e.move;
+				}
+				break;
+			}
+			misses.fetch_add(1, std::memory_order_relaxed);
+			return -1;
+		}
+		//records the move a completed search chose for a board, along with the
+		//chosen child's visits and its share of the root's visits
+		template <class P>
+		void store(const P& p, int move, int visits, double share){
+			if(move < 0 || visits <= 0)	return;
+			stores.fetch_add(1, std::memory_order_relaxed);
+			uint64_t low, high;
+			cache_slot* b = bucket(p, low, high);
+			cache_slot* victim = NULL;
+			int fewest = INT32_MAX;
+			for(int i = 0; i < CACHE_BUCKET; i++){
+				uint64_t data = read(b[i], low, high, P::CELLS);
+				if(data != 0){
+					cache_entry e = unpack(data);
+					if(e.move == move){
+						//an agreeing search keeps the stronger of the two
+						if(e.visits > visits){
+							visits = e.visits;
+							share = e.share;
+						}
+					}
+					else if(visits < e.visits){
+						//a weaker search disagreeing wears the slot down
+						visits = e.visits - visits;
+						share = e.share;
+						move = e.move;
+					}
+					write(b[i], low, high, pack(move, P::CELLS, visits, share));
+					return;
+				}
+				//empty slots first, then the fewest visits
+				uint64_t raw = __atomic_load_n(&b[i].data, __ATOMIC_RELAXED);
+				int held = raw == 0 ? -1 : unpack(raw).visits;
+				if(held < fewest){
+					fewest = held;
+					victim = &b[i];
+				}
+			}
+			write(*victim, low, high, pack(move, P::CELLS, visits, share));
+		}
+		uint64_t hit_count() const{
+			return hits.load(std::memory_order_relaxed);
+		}
+		uint64_t miss_count() const{
+			return misses.load(std::memory_order_relaxed);
+		}
+		uint64_t store_count() const{
+			return stores.load(std::memory_order_relaxed);
+		}
+		//slots in the file and how many of them hold a board
+		size_t capacity() const{
+			return (mask + 1) * CACHE_BUCKET;
+		}
+		size_t filled() const{
+			size_t count = 0;
+			for(size_t i = 0; i < capacity(); i++)
+				if(__atomic_load_n(&slots[i].data, __ATOMIC_RELAXED) != 0)	count++;
+			return count;
+		}
+};
+
+#endif
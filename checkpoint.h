@@ -0,0 +1,162 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*	Tree checkpoints:
+	search trees written to a file so a later run can start from them. The
+	file is a fixed size header followed by every tree's nodes, one 32 byte
+	record per node, the trees one after another. A tree's records are in
+	breadth first order from its root, so the first record holding a board is
+	the shallowest, and every expanded node's four children are four records
+	in a row, one per move index, invalid moves included as an empty board
+	and children never built as an unvisited record of the board they would
+	hold. Children are found by the index of the first of them within the
+	tree, 0 for a leaf since the root is never a child.
+
+	Loading maps the file read only and builds the visited nodes straight
+	from the records, taking each from the arena. The header is checked when
+	the file is mapped, and each record when its node is built: a child's
+	board has to be the one its parent's move leads to, so a corrupt record
+	is reported rather than searched.
+*/
+
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_MAGIC "MCTSTREE"
+#define CHECKPOINT_MAX_TREES 64
+
+struct checkpoint_node{
+	//packed board split into two words, 0 for an invalid move
+	uint64_t board_low;
+	uint64_t board_high;
+	double total_val;
+	int32_t visits;
+	uint32_t children;
+};
+
+struct checkpoint_header{
+	char magic[8];
+	uint32_t version;
+	//shape of the puzzle the trees were searched for
+	uint32_t rows;
+	uint32_t columns;
+	uint32_t trees;
+	//records in each tree
+	uint64_t nodes[CHECKPOINT_MAX_TREES];
+};
+
+/*checkpoint_file class:
+	a checkpoint mapped read only into memory
+*/
+class checkpoint_file{
+	private:
+		void* mapping;
+		size_t bytes;
+		const checkpoint_header* header;
+	public:
+		checkpoint_file(){
+			mapping = NULL;
+			bytes = 0;
+			header = NULL;
+		}
+		~checkpoint_file(){
+			if(mapping != NULL)	munmap(mapping, bytes);
+		}
+		//checkpoints own their mapping, so they cannot be copied
+		checkpoint_file(const checkpoint_file&) = delete;
+		checkpoint_file& operator=(const checkpoint_file&) = delete;
+
+		//maps the file at path, returning NULL on success or what was wrong
+		//with the file, in which case the checkpoint is left empty
+		const char* load(const char* path){
+			int fd = open(path, O_RDONLY);
+			if(fd < 0)	return "could not open file";
+			struct stat info;
+			if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(checkpoint_header)){
+				close(fd);
+				return "file too short";
+			}
+			void* m = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if(m == MAP_FAILED)	return "could not map file";
+			const checkpoint_header* h = (const checkpoint_header*)m;
+			const char* error = NULL;
+			uint64_t total = 0;
+			if(memcmp(h->magic, CHECKPOINT_MAGIC, 8) != 0)	error = "not a tree checkpoint";
+			else if(h->version != CHECKPOINT_VERSION)	error = "wrong version";
+			else if(h->trees < 1 || h->trees > CHECKPOINT_MAX_TREES)	error = "bad tree count";
+			else{
+				for(uint32_t t = 0; t < h->trees; t++){
+					if(h->nodes[t] < 1 || h->nodes[t] > UINT32_MAX)	error = "bad tree size";
+					total += h->nodes[t];
+				}
+				if(error == NULL && sizeof(checkpoint_header) + total * sizeof(checkpoint_node)
+						    > (uint64_t)info.st_size)
+					error = "file too short";
+			}
+			if(error != NULL){
+				munmap(m, info.st_size);
+				return error;
+			}
+			if(mapping != NULL)	munmap(mapping, bytes);
+			mapping = m;
+			bytes = info.st_size;
+			header = h;
+			return NULL;
+		}
+		int rows() const{
+			return header->rows;
+		}
+		int columns() const{
+			return header->columns;
+		}
+		int trees() const{
+			return header->trees;
+		}
+		//the records of tree t, and how many there are
+		const checkpoint_node* tree(int t, uint64_t& count) const{
+			const checkpoint_node* records = (const checkpoint_node*)(header + 1);
+			for(int i = 0; i < t; i++)	records += header->nodes[i];
+			count = header->nodes[t];
+			return records;
+		}
+};
+
+//writes trees of records to path, returning NULL on success or what went
+//wrong. The file is written beside path and renamed over it once complete,
+//so a run stopped partway through never leaves half a checkpoint behind.
+inline const char* write_checkpoint(const char* path, int rows, int columns,
+				    const std::vector<std::vector<checkpoint_node>>& trees){
+	if(trees.empty() || trees.size() > CHECKPOINT_MAX_TREES)	return "bad tree count";
+	checkpoint_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+	header.version = CHECKPOINT_VERSION;
+	header.rows = rows;
+	header.columns = columns;
+	header.trees = trees.size();
+	for(size_t t = 0; t < trees.size(); t++)	header.nodes[t] = trees[t].size();
+	std::string temporary = std::string(path) + ".tmp";
+	FILE* out = fopen(temporary.c_str(), "wb");
+	if(out == NULL)	return "could not open file";
+	bool written = fwrite(&header, sizeof(header), 1, out) == 1;
+	for(size_t t = 0; written && t < trees.size(); t++)
+		written = fwrite(trees[t].data(), sizeof(checkpoint_node), trees[t].size(), out)
+			  == trees[t].size();
+	if(fclose(out) != 0)	written = false;
+	if(!written || rename(temporary.c_str(), path) != 0){
+		remove(temporary.c_str());
+		return "could not write file";
+	}
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,246 @@
+/* 	client.cpp
+	This program drives a solver started with mcts --serve, for checking it
+	works and for load testing it. It reads boards, one line of 9, 16 or 25
+	tiles each, sends each of them as a SOLVE request, and reports how many
+	were solved, the throughput, and the latency of the requests along with
+	the time they spent queued in the service.
+
+	usage: client SOCKET [--file PATH] [--connections N] [--repeat K]
+		      [--deadline MS] [--seed N] [--echo]
+	Boards are read from standard input unless a file is given, and are sent
+	K times over N connections at once, request n using seed N plus n. With
+	--echo every line the service sends back is printed as well.
+
+	Each connection has one thread writing its requests and another reading
+	the replies, so requests are sent as fast as the service takes them and
+	its backpressure shows up as latency rather than as a stalled client.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+//what came back for every request, filled in by the reading threads
+struct client_totals{
+	mutex lock;
+	long long boards;
+	long long solved;
+	long long errors;
+	long long moves;
+	double queued_total;
+	double queued_max;
+	vector<double> latencies;
+	client_totals(){
+		boards = solved = errors = moves = 0;
+		queued_total = queued_max = 0;
+	}
+};
+
+//connects to the service, returning the socket or -1
+static int connect_to(const char* path){
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path))	return -1;
+	strcpy(address.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0)	return -1;
+	if(connect(fd, (sockaddr*)&address, sizeof(address)) != 0){
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+//the number after "name": in a line of JSON, 0 if it is missing
+static double field(const string& line, const char* name){
+	string key = string("\"") + name + "\":";
+	size_t at = line.find(key);
+	if(at == string::npos)	return 0;
+	return strtod(line.c_str() + at + key.size(), NULL);
+}
+
+static bool send_all(int fd, const string& data){
+	size_t sent = 0;
+	while(sent < data.size()){
+		ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR)	continue;
+		if(n <= 0)	return false;
+		sent += n;
+	}
+	return true;
+}
+
+//sends requests first, first + stride and so on, then closes the writing side
+static void writer(int fd, const vector<string>* boards, long long first, long long stride,
+		   long long total, uint64_t seed, double deadline, vector<atomic<long long>>* sent){
+	for(long long id = first; id < total; id += stride){
+		ostringstream request;
+		request<<"SOLVE "<<id<<" "<<seed + id<<" "<<deadline<<" "<<(*boards)[id % boards->size()]<<"\n";
+		(*sent)[id] = chrono::duration_cast<chrono::nanoseconds>(
+				chrono::steady_clock::now().time_since_epoch()).count();
+		if(!send_all(fd, request.str()))	break;
+	}
+	shutdown(fd, SHUT_WR);
+}
+
+//reads replies until the service closes the connection
+static void reader(int fd, vector<atomic<long long>>* sent, client_totals* totals, bool echo,
+		   mutex* output){
+	string buffer;
+	char chunk[4096];
+	while(true){
+		ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+		if(n < 0 && errno == EINTR)	continue;
+		if(n <= 0)	break;
+		buffer.append(chunk, n);
+		size_t end;
+		while((end = buffer.find('\n')) != string::npos){
+			string line = buffer.substr(0, end);
+			buffer.erase(0, end + 1);
+			if(echo){
+				lock_guard<mutex> guard(*output);
+				cout<<line<<endl;
+			}
+			bool board = line.find("\"type\":\"board\"") != string::npos;
+			bool error = line.find("\"type\":\"error\"") != string::npos;
+			if(!board && !error)	continue;
+			long long now = chrono::duration_cast<chrono::nanoseconds>(
+					chrono::steady_clock::now().time_since_epoch()).count();
+			long long id = (long long)field(line, "id");
+			lock_guard<mutex> guard(totals->lock);
+			if(error){
+				totals->errors++;
+				continue;
+			}
+			totals->boards++;
+			if(line.find("\"solved\":true") != string::npos)	totals->solved++;
+			totals->moves += (long long)field(line, "moves");
+			double queued = field(line, "queue_ms");
+			totals->queued_total += queued;
+			if(queued > totals->queued_max)	totals->queued_max = queued;
+			if(id >= 0 && id < (long long)sent->size())
+				totals->latencies.push_back((now - (*sent)[id]) / 1e6);
+		}
+	}
+}
+
+int main(int argc, char** argv){
+	if(argc < 2 || argv[1][0] == '-'){
+		cout<<"usage: "<<argv[0]<<" SOCKET [--file PATH] [--connections N] [--repeat K]"
+		    <<" [--deadline MS] [--seed N] [--echo]"<<endl;
+		return 1;
+	}
+	const char* path = argv[1];
+	const char* file = NULL;
+	int connections = 1;
+	int repeat = 1;
+	double deadline = 0;
+	uint64_t seed = 1;
+	bool echo = false;
+	for(int i = 2; i < argc; i++){
+		if(strcmp(argv[i], "--file") == 0 && i + 1 < argc)
+			file = argv[++i];
+		else if(strcmp(argv[i], "--connections") == 0 && i + 1 < argc)
+			connections = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+			repeat = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--deadline") == 0 && i + 1 < argc)
+			deadline = atof(argv[++i]);
+		else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], NULL, 10);
+		else if(strcmp(argv[i], "--echo") == 0)
+			echo = true;
+		else{
+			cout<<"usage: "<<argv[0]<<" SOCKET [--file PATH] [--connections N] [--repeat K]"
+			    <<" [--deadline MS] [--seed N] [--echo]"<<endl;
+			return 1;
+		}
+	}
+	if(connections < 1)	connections = 1;
+	if(repeat < 1)	repeat = 1;
+
+	vector<string> boards;
+	ifstream in;
+	if(file != NULL){
+		in.open(file);
+		if(!in){
+			cout<<"COULD NOT OPEN "<<file<<". EXITING."<<endl;
+			return 1;
+		}
+	}
+	string line;
+	while(getline(file != NULL ? in : cin, line))
+		if(line.find_first_not_of(" \t\r") != string::npos)	boards.push_back(line);
+	if(boards.empty()){
+		cout<<"NO BOARDS TO SEND. EXITING."<<endl;
+		return 1;
+	}
+
+	long long total = (long long)boards.size() * repeat;
+	if(connections > total)	connections = total;
+	vector<atomic<long long>> sent(total);
+	client_totals totals;
+	mutex output;
+	vector<int> sockets;
+	for(int c = 0; c < connections; c++){
+		int fd = connect_to(path);
+		if(fd < 0){
+			cout<<"COULD NOT CONNECT TO "<<path<<": "<<strerror(errno)<<". EXITING."<<endl;
+			for(size_t s = 0; s < sockets.size(); s++)	close(sockets[s]);
+			return 1;
+		}
+		sockets.push_back(fd);
+	}
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	vector<thread> threads;
+	for(int c = 0; c < connections; c++){
+		threads.push_back(thread(writer, sockets[c], &boards, (long long)c, (long long)connections,
+					 total, seed, deadline, &sent));
+		threads.push_back(thread(reader, sockets[c], &sent, &totals, echo, &output));
+	}
+	for(size_t t = 0; t < threads.size(); t++)	threads[t].join();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	for(int c = 0; c < connections; c++)	close(sockets[c]);
+
+	vector<double>& latencies = totals.latencies;
+	sort(latencies.begin(), latencies.end());
+	double mean = 0;
+	for(size_t i = 0; i < latencies.size(); i++)	mean += latencies[i];
+	if(!latencies.empty())	mean /= latencies.size();
+	cout<<"SENT "<<total<<" REQUESTS OVER "<<connections<<" CONNECTIONS IN "<<seconds<<" SECONDS"<<endl;
+	cout<<"SOLVED "<<totals.solved<<" OF "<<totals.boards<<" BOARDS, "<<totals.errors<<" ERRORS"<<endl;
+	cout<<"THROUGHPUT: "<<totals.boards / seconds<<" BOARDS/S, "<<totals.moves / seconds<<" MOVES/S"<<endl;
+	if(!latencies.empty()){
+		cout<<"LATENCY MS: MEAN "<<mean<<", P50 "<<latencies[latencies.size() / 2]
+		    <<", P95 "<<latencies[latencies.size() * 95 / 100]<<", MAX "<<latencies.back()<<endl;
+		cout<<"QUEUED MS: MEAN "<<totals.queued_total / totals.boards<<", MAX "<<totals.queued_max<<endl;
+	}
+	//the service's own view, over every client it has served
+	int fd = connect_to(path);
+	if(fd >= 0 && send_all(fd, "STATS\n")){
+		shutdown(fd, SHUT_WR);
+		string reply;
+		char chunk[4096];
+		ssize_t n;
+		while((n = recv(fd, chunk, sizeof(chunk), 0)) > 0)	reply.append(chunk, n);
+		cout<<"SERVICE: "<<reply;
+	}
+	if(fd >= 0)	close(fd);
+	return 0;
+}
@@ -1,360 +1,851 @@
 
 /* 	mcts.cpp written by Conor Harrigan
-	This program implements the monte-carlo tree search algorithm
-	in order to solve a fifteen puzzle, working alongside puzzlefile.h
-
-	The algorithm has four steps:
-		1. Traversing
-			The algorithm traverses over already-explored elements
-			of the tree using UCB1 criteria, defined in the UCB1 method.
-			After following these criteria to a leaf node, the second step starts
-		2. Expansion
-			Once a leaf node is reached, it has either been unvisited or not.
-			If unvisited, step three starts. If visited, then all children for
-			possible actions are expanded and added to the tree. In this 
-			implementation, there are four actions that any node can take
-			(although on occasion fewer, as the boundaries of the puzzle have
-			fewer valid moves). After expanding children nodes and selecting
-			one, step three begins.
-		3. Random Walk
-			Now at a leaf node, the algorithm begins to randomly select moves 
-			and follow down a random path. In this implementation the criteria
-			for stopping the random walk is a set limit of iterations.
-		4. Backpropagate
-			Now at some deep internal node, all the estimated values achieved at each 
-			node are computed and set back up the chain to the starting leaf node
-			and eventually the root. This is implemented in a two step process with
-			the first step being the temporary  random walk nodes, done 
-			recursively back to the leaf node, and the second step being the nodes 
-			on the tree back to the root.
+	This program runs the monte-carlo tree search in mcts.h on a fifteen
+	puzzle read from standard input, making moves until the goal is reached,
+	or with --solve-file on a stream of puzzles solved by a pool of workers.
+	See mcts.h for the algorithm itself.
 */
 
-#include "puzzlefile.h"
+#include "mcts.h"
+#include "queue.h"
 #include <iostream>
-#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
 #include <cstring>
-#include <cmath>
-#include <cfloat>
-
-
-#define RANDOM_WALK_ITERATIONS 200
-#define MCTS_ITERATIONS 20
-#define C_CONST 2.0
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 using namespace std;
 
-/*      Random walk function
-                        This function recursively creates temporary puzzles that are
-                        not linked to any Node. It randomly picks a move to make and 
-			proceeds down the walk. I opted to make this a function and
-			not a method because the Node architecture is unnecessary as no
-			tree needs to be stored or used.
-		
-                        There are two possible failures in proceeding:
-                                1. move randomly selected was invalid
-                                2. move randomly selected was valid, but the valid move
-                                   nondeterministically failed
-                        In the first case the algorithm wont be punished since a smarter
-                        implementation could avoid this
-                        However in the second case the whole iteration will fail, and miss out
-                        on the value provided had the move been successful, so the program will 
-                        learn from low-probalility moves that the expected value is lower
+//moves allowed per board in batch mode before it counts as unsolved
+#define BATCH_MAX_MOVES 1000
+//tiles in the largest puzzle the program is built for, the 24 puzzle
+#define MAX_TILES 25
+
+/*	Scaling report:
+	measures decision quality against thread count at a fixed wall clock
+	budget per decision. A reference move is decided first by a single thread
+	given ten times the budget of the widest search. Then for each thread
+	count, several differently seeded searches decide a move from the same
+	board within the budget, and the report gives the iterations they managed
+	per decision, how often they agreed with the reference, and the average
+	merged value of the moves they chose.
 */
-double random_walk(int iterations, fifteen_puzzle state){
-	//base case, number of iterations reached
-	if(iterations < 0)	return 0.0;
-	//randomly selecting a move until one is valid
-	int move = rand()%4;
-	while(!state.valid_swap(map[move]))	move = rand()%4;
-	//now with a valid move, time to see if it was randomly successful
-	if(!state.swap(map[move])){
-		//within if, move was unsuccessful, so try again and miss out on 
-		//an iteration of returns
-		return random_walk(iterations - 1, state);
+template <class P>
+void scaling_report(const search_options& options, const P& board, uint64_t seed,
+		    double seconds, int max_threads){
+	const int trials = 10;
+	//one tree per thread, whatever number of replicas was asked for
+	search_options single = options;
+	single.threads = 1;
+	single.replicas = 0;
+	search_limits reference_limits;
+	reference_limits.iterations = INT32_MAX;
+	reference_limits.seconds = seconds * 10 * max_threads;
+	root_parallel<P> reference(single, seed, board);
+	reference.search(reference_limits);
+	char best = reference.pick_move();
+	cout<<"REFERENCE MOVE "<<best<<" AFTER "<<reference.iterations()<<" ITERATIONS"<<endl;
+	cout<<"threads\titerations\tagreement\tchosen_value"<<endl;
+	for(int threads = 1; threads <= max_threads; threads *= 2){
+		long long iterations = 0;
+		int agreed = 0;
+		double value = 0;
+		search_options wide = options;
+		wide.threads = threads;
+		wide.replicas = 0;
+		search_limits limits;
+		limits.iterations = INT32_MAX;
+		limits.seconds = seconds;
+		for(int t = 0; t < trials; t++){
+			tree_search<P>* search = make_search(wide, seed + 1 + t, board);
+			search->search(limits);
+			int index = search->pick_child();
+			iterations += search->iterations();
+			if(index >= 0 && map[index] == best)	agreed++;
+			if(index >= 0)	value += search->child_average(index);
+			delete search;
+		}
+		cout<<threads<<"\t"<<iterations / trials<<"\t"<<(double)agreed / trials
+		    <<"\t"<<value / trials<<endl;
+		//making sure the widest run is always reported
+		if(threads < max_threads && threads * 2 > max_threads)	threads = max_threads / 2;
 	}
-	//outside if, swap was successful return current value plus value of further iterations
-	double result = state.heuristic();
-	result += random_walk(iterations - 1, state);
-	return result;
 }
 
-
-/*	Node class:
-	This class is used by the monte carlo tree search and is the
-	implementation of the tree. Each node will typically have
-	four children, though nodes representing the "sides" of the puzzle
-	will have three, and the nodes representing the "corners" will have two.
+/*	Batch solver:
+	streams boards, one line of 9, 16 or 25 tiles each, from a file or standard
+	input and solves them on a fixed pool of workers. The reading thread parses
+	a line at a time into a bounded queue, so the input is never held in memory
+	all at once. Each worker owns a search for every puzzle size it has been
+	given, with its own generators, arenas and tables, reset for every board. Board n is always solved with seed
+	plus n, so its result does not depend on which worker got it. Results are
+	written as CSV or NDJSON lines in the order they finish, each carrying the
+	board's index; lines that are not a solvable board are reported with an error.
 */
-class Node{
-	private:
-		//array for child pointers, will always be an array of four
-		//even though not every node will have four children
-		Node *children;
-		//tracking number of times a node is visited (updated during backpropagation)
-		int visits;
-		//tracking total value of a node (updated during backpropagation)
-		double total_val;
-		//parent pointer
-		Node* parent;
-		//puzzle held within each node representing the state
-		fifteen_puzzle state;
-		bool valid;
-		bool leaf;
-	public:
-		//method to return a pointer to one of a Node's children
-		Node getChild(int index){
-			return children[index];
-		}
-		//method to retrieve number of visits
-		int getVisits(){
-			return visits;
-		}
-		//method to retrieve total value
-		double getValue(){
-			return total_val;
-		}
-		//method to retrieve state
-		fifteen_puzzle getState(){
-			return state;
-		}
-		//constructor that copies over a state and takes in a parent pointer
-		Node(Node* par, fifteen_puzzle p){
-			children = NULL;
-			state.copy(p);
-			total_val = state.heuristic();
-			visits = 0;
-			parent = par;
-			valid = true;
-			leaf = true;
+struct batch_job{
+	long long index;
+	int tiles[MAX_TILES];
+	int count;
+	const char* error;
+};
+
+//reads the tiles on a line, returning how many there were, or -1 if a
+//token is not a number or there are too many of them
+int read_tiles(const string& line, int* tiles){
+	istringstream in(line);
+	int count = 0;
+	int value;
+	while(in>>value){
+		if(count == MAX_TILES)	return -1;
+		tiles[count++] = value;
+	}
+	if(!in.eof())	return -1;
+	return count;
+}
+
+//checks a board's tiles, returning why they are not a solvable board or NULL
+const char* check_board(const int* tiles, int count){
+	int width = count == 9 ? 3 : count == 16 ? 4 : count == 25 ? 5 : 0;
+	if(width == 0)	return "wrong number of tiles";
+	bool seen[MAX_TILES] = {false};
+	for(int i = 0; i < count; i++){
+		if(tiles[i] < 0 || tiles[i] >= count)	return "tile out of range";
+		if(seen[tiles[i]])	return "repeated tile";
+		seen[tiles[i]] = true;
+	}
+	//an odd width board is solvable when its inversions are even, and an even
+	//width board when its inversions and the row of the empty tile counted
+	//from the bottom add up to an odd number
+	int inversions = 0;
+	int row = 0;
+	for(int i = 0; i < count; i++){
+		if(tiles[i] == 0){
+			row = width - i / width;
+			continue;
 		}
-		//basic constructor, used to create invalid children
-		Node(){
-			children = NULL;
-			visits = INT8_MAX;
-			total_val = 0;
-			parent = NULL;
-			state = NULL;
-			valid = false;
-			leaf = false;
+		for(int j = i + 1; j < count; j++)
+			if(tiles[j] != 0 && tiles[j] < tiles[i])	inversions++;
+	}
+	if(width % 2 == 1 && inversions % 2 == 1)	return "unsolvable";
+	if(width % 2 == 0 && (inversions + row) % 2 == 0)	return "unsolvable";
+	return NULL;
+}
+
+//solves a job with the worker's search for its size, building the search
+//the first time the worker sees a board of that size
+template <class P>
+solve_result solve_job(tree_search<P>*& search, batch_job& job, const search_options& options,
+		       uint64_t seed, int max_moves){
+	P board(job.tiles);
+	if(search == NULL)	search = make_search(options, seed, board);
+	return solve(*search, board, options.limits, seed + job.index, max_moves, options.cache);
+}
+
+void batch_worker(bounded_queue<batch_job>* jobs, const search_options* options, uint64_t seed,
+		  int max_moves, bool csv, mutex* output){
+	tree_search<eight_puzzle>* small = NULL;
+	tree_search<fifteen_puzzle>* medium = NULL;
+	tree_search<twenty_four_puzzle>* large = NULL;
+	batch_job job;
+	while(jobs->pop(job)){
+		solve_result result;
+		if(job.error == NULL && job.count == 9)
+			result = solve_job(small, job, *options, seed, max_moves);
+		else if(job.error == NULL && job.count == 16)
+			result = solve_job(medium, job, *options, seed, max_moves);
+		else if(job.error == NULL && job.count == 25)
+			result = solve_job(large, job, *options, seed, max_moves);
+		ostringstream line;
+		if(csv){
+			line<<job.index<<","<<(result.solved ? "true" : "false")<<","<<result.moves<<","
+			    <<result.seconds * 1000<<","<<result.iterations<<","<<result.rollouts<<","
+			    <<(job.error == NULL ? "" : job.error);
 		}
-		//constructor for root node, given a starting fifteen puzzle
-		Node(fifteen_puzzle p){
-			children = NULL;
-			visits = 0;
-			total_val = p.heuristic();
-			parent = NULL;
-			state.copy(p);
-			valid = true;
-			leaf = true;
+		else{
+			line<<"{\"type\":\"board\",\"index\":"<<job.index
+			    <<",\"solved\":"<<(result.solved ? "true" : "false")
+			    <<",\"moves\":"<<result.moves<<",\"ms\":"<<result.seconds * 1000
+			    <<",\"iterations\":"<<result.iterations<<",\"rollouts\":"<<result.rollouts;
+			if(options->cache != NULL)	line<<",\"cached\":"<<result.cached;
+			if(job.error != NULL)	line<<",\"error\":\""<<job.error<<"\"";
+			line<<"}";
 		}
-		Node operator=(const Node& n){
-			visits = 0;
-			total_val = n.state.heuristic();
-			state.copy(n.state);
-			parent = n.parent;
-			leaf = true;
-			children = NULL;
-			valid = true;
+		lock_guard<mutex> guard(*output);
+		cout<<line.str()<<endl;
+	}
+	delete small;
+	delete medium;
+	delete large;
+}
+
+void batch_solve(istream& in, const search_options& options, int workers, uint64_t seed,
+		 int max_moves, bool csv){
+	bounded_queue<batch_job> jobs(workers * 4);
+	mutex output;
+	if(csv)	cout<<"index,solved,moves,ms,iterations,rollouts,error"<<endl;
+	vector<thread> pool;
+	for(int w = 0; w < workers; w++)
+		pool.push_back(thread(batch_worker, &jobs, &options, seed, max_moves, csv, &output));
+	string line;
+	long long index = 0;
+	while(getline(in, line)){
+		//blank lines are skipped without using up an index
+		if(line.find_first_not_of(" \t\r") == string::npos)	continue;
+		batch_job job;
+		job.index = index++;
+		job.count = read_tiles(line, job.tiles);
+		job.error = job.count < 0 ? "unreadable tiles" : check_board(job.tiles, job.count);
+		jobs.push(job);
+	}
+	jobs.close();
+	for(size_t w = 0; w < pool.size(); w++)	pool[w].join();
+	if(!csv && options.cache != NULL)
+		cout<<"{\"type\":\"cache\",\"hits\":"<<options.cache->hit_count()
+		    <<",\"misses\":"<<options.cache->miss_count()
+		    <<",\"stores\":"<<options.cache->store_count()
+		    <<",\"filled\":"<<options.cache->filled()
+		    <<",\"slots\":"<<options.cache->capacity()<<"}"<<endl;
+}
+
+/*	Solver service:
+	with --serve PATH the program keeps running and solves boards sent to it
+	over a Unix domain socket at PATH, so that the pattern databases, the
+	position cache and the workers' searches stay warm from board to board.
+	Clients send one request per line:
+		SOLVE ID SEED DEADLINE_MS TILES...
+		STATS
+	A SOLVE request plays its board out the way solve() does with SEED, and
+	a line of JSON is sent back for every move as soon as it is decided,
+	followed by one for the board. DEADLINE_MS bounds the whole request from
+	the moment it is read, time spent in the queue included, 0 for no
+	deadline, and every move's search is cut short to fit in what is left of
+	it. STATS reports the depth of the queue and how long requests waited in it.
+
+	Every connection has a thread reading its requests onto the bounded queue
+	shared by the pool of workers. While the queue is full the reading thread
+	waits, so it stops reading the socket and the client's writes block in
+	turn. A worker stops a board early once its client has gone away. The
+	service runs until it is killed, removing its socket on SIGINT or SIGTERM.
+*/
+struct service_connection{
+	int fd;
+	mutex lock;
+	atomic<bool> open;
+	service_connection(int fd){
+		this->fd = fd;
+		open = true;
+	}
+	//the socket is closed once the reader and every queued job are done with it
+	~service_connection(){
+		close(fd);
+	}
+	//writes a whole line, returning false once the client has gone away
+	bool send_line(const string& line){
+		lock_guard<mutex> guard(lock);
+		if(!open)	return false;
+		string data = line + "\n";
+		size_t sent = 0;
+		while(sent < data.size()){
+			ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+			if(n < 0 && errno == EINTR)	continue;
+			if(n <= 0){
+				open = false;
+				return false;
+			}
+			sent += n;
 		}
-		//method to check if a Node is a goal node, using goal_test in puzzlefile
-		bool is_goal(){
-			if(state.goal_test())	return true;
-			return false;
+		return true;
+	}
+};
+
+struct service_job{
+	long long id;
+	uint64_t seed;
+	//seconds allowed from received, 0 for no deadline
+	double deadline;
+	int tiles[MAX_TILES];
+	int count;
+	chrono::steady_clock::time_point received;
+	shared_ptr<service_connection> client;
+};
+
+//requests served and the time they spent queued, shared by every worker
+struct service_stats{
+	mutex lock;
+	long long served;
+	double queued_total;
+	double queued_max;
+	atomic<int> active;
+	service_stats(){
+		served = 0;
+		queued_total = 0;
+		queued_max = 0;
+		active = 0;
+	}
+	void add(double queued){
+		lock_guard<mutex> guard(lock);
+		served++;
+		queued_total += queued;
+		if(queued > queued_max)	queued_max = queued;
+	}
+};
+
+//plays a job's board out, streaming every move back to its client
+template <class P>
+void serve_job(tree_search<P>*& search, service_job& job, const search_options& options,
+	       int max_moves, double queued){
+	P board(job.tiles);
+	if(search == NULL)	search = make_search(options, job.seed, board);
+	search->reset(board, job.seed);
+	//the same environment generator as solve(), so a seed plays the same game
+	xoshiro256 environment(job.seed ^ 0xD1B54A32D192ED03ULL);
+	solve_result result;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	const char* stop = "goal";
+	while(!board.goal_test()){
+		if(result.moves >= max_moves){
+			stop = "max-moves";
+			break;
 		}
-		//method to expand children out, using a constructor
-		void expand(){
-			fifteen_puzzle p;
-			children = new Node[4];
-			//looping through and adding all children, specifying if theyre valid or not
-			for(int i = 0; i < 4; i++){
-				//if a move is invalid, sent to basic constructor
-				if(!state.valid_swap(map[i])){
-					children[i] = Node();
-					continue;
-				}
-				children[i] = Node(this, fifteen_puzzle(state, map[i]));
+		search_limits limits = options.limits;
+		if(job.deadline > 0){
+			double left = job.deadline
+				    - chrono::duration<double>(chrono::steady_clock::now() - job.received).count();
+			if(left <= 0){
+				stop = "deadline";
+				break;
 			}
-			leaf = false;
+			if(limits.seconds == 0 || left < limits.seconds)	limits.seconds = left;
 		}
-		/*	UCB1 method returns the UCB1 value associated with a Node
-			The UUCB1 formula is as follows:
-			avg value + C*sqrt(lnN/n)
-			C is some constant exploration factor
-			N is the number of visits from the parent node
-			n is the number of visits on the current node
-		*/
-		double UCB1(){
-			//return if in the root node
-			if(parent == NULL) return 0;
-			int N = parent->getVisits();
-			if(visits == 0){
-				return DBL_MAX;	//return max value for unvisited Nodes
-			}	
-			double result = total_val/(double)visits + 
-					C_CONST * sqrt( log(N) /(double)visits);
-			return result;
+		search_report report = search_report();
+		int index = options.cache == NULL ? -1 : options.cache->lookup(board);
+		if(index >= 0){
+			report.stop = "cache";
+			result.moves++;
+			result.cached++;
 		}
-		//prints state and every child's state, as well as visits and total values
-		void print(){
-			cout<<"***********************"<<endl;
-			cout<<"Total Value:\t"<<total_val<<endl;
-			cout<<"Num Visits:\t"<<visits<<endl;
-			cout<<"Avg Value:\t";
-				if(visits == 0)	cout<<"Infinity"<<endl;
-				else		cout<<total_val/(double)visits<<endl;
-			cout<<"UCB1 SCORE:\t"<<UCB1()<<endl;
-			cout<<"Heuristic:\t"<<state.heuristic()<<endl;
-			state.print();
-			if(children == NULL){
-				cout<<"******NO CHILDREN******"<<endl;
-				return;
-			}
-			cout<<"***PRINTING CHILDREN***"<<endl;
-			for(int i = 0; i < 4; i++){
-				if(!children[i].valid){
-					cout<<"Skipped invalid child with move "<<map[i]<<endl;
-					continue;
-				}
-				cout<<"MOVE: "<<map[i]<<endl;
-				cout<<"Total Value:\t"<<children[i].total_val<<endl;
-				cout<<"Num Visits:\t"<<children[i].visits<<endl;
-				cout<<"Avg Value:\t";
-					if(visits == 0)	cout<<"Infinity"<<endl;
-					else 		cout<<total_val/(double)visits<<endl;
-				cout<<"UCB1 Score: \t"<<children[i].UCB1()<<endl;
-				cout<<"Heuristic:\t"<<children[i].state.heuristic()<<endl;
-				children[i].state.print();
-			}
+		else{
+			report = search->search(limits);
+			result.add(report);
+			if(options.cache != NULL)	cache_decision(*options.cache, *search, board);
+			index = search->pick_child();
 		}
-		//method that returns the number of nodes further in the tree, exclusing invalid ones
-		int size(){
-			int result = 0;
-			if(!valid)	return 0;
-			if(leaf)	return 1;
-			for(int i = 0; i < 4; i++){
-				result += children[i].size();
-			}
-			return 1 + result;
+		char move = index < 0 ? 'Z' : map[index];
+		board.swap(move, environment);
+		search->reroot(board);
+		ostringstream line;
+		line<<"{\"type\":\"move\",\"id\":"<<job.id<<",\"index\":"<<result.moves - 1
+		    <<",\"move\":\""<<move<<"\",\"iterations\":"<<report.iterations
+		    <<",\"ms\":"<<report.seconds * 1000<<",\"stop\":\""<<report.stop<<"\"}";
+		if(!job.client->send_line(line.str())){
+			stop = "disconnected";
+			break;
 		}
+	}
+	result.solved = board.goal_test();
+	result.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	ostringstream line;
+	line<<"{\"type\":\"board\",\"id\":"<<job.id<<",\"solved\":"<<(result.solved ? "true" : "false")
+	    <<",\"moves\":"<<result.moves<<",\"cached\":"<<result.cached
+	    <<",\"iterations\":"<<result.iterations<<",\"rollouts\":"<<result.rollouts
+	    <<",\"queue_ms\":"<<queued * 1000<<",\"ms\":"<<result.seconds * 1000
+	    <<",\"stop\":\""<<stop<<"\"}";
+	job.client->send_line(line.str());
+}
 
-		//this method contains and drives all four steps of the tree search
-		void mcts(){
+void service_worker(bounded_queue<service_job>* jobs, const search_options* options, int max_moves,
+		    service_stats* stats){
+	tree_search<eight_puzzle>* small = NULL;
+	tree_search<fifteen_puzzle>* medium = NULL;
+	tree_search<twenty_four_puzzle>* large = NULL;
+	service_job job;
+	while(jobs->pop(job)){
+		double queued = chrono::duration<double>(chrono::steady_clock::now() - job.received).count();
+		stats->add(queued);
+		stats->active++;
+		if(job.count == 9)	serve_job(small, job, *options, max_moves, queued);
+		else if(job.count == 16)	serve_job(medium, job, *options, max_moves, queued);
+		else	serve_job(large, job, *options, max_moves, queued);
+		stats->active--;
+		//letting go of the connection, so it closes once its client is served
+		job.client.reset();
+	}
+	delete small;
+	delete medium;
+	delete large;
+}
 
-		//step one: finding a leaf node based off ucb1
-			Node* current = this;
-			//follow UCB1 down until a leaf node is reached
-			while(!current->leaf){
-				//the pick child method returns the index of the optimal 
-				//child to follow using ucb1
-				int index = current->pick_child();
-				//updating current
-				if(index < 0 || index > 3)	break;
-				current  = &current->children[index];
-			}
-			//now current points to a leaf node, need to check if already visited
-			if(current->visits != 0){
-				//already visited, expand children and pick one
+//answers one request line, queueing it if it is a board to solve
+void service_request(const string& request, const shared_ptr<service_connection>& client,
+		     bounded_queue<service_job>* jobs, service_stats* stats, const search_options* options){
+	istringstream in(request);
+	string command;
+	if(!(in>>command))	return;
+	if(command == "STATS"){
+		ostringstream line;
+		{
+			lock_guard<mutex> guard(stats->lock);
+			line<<"{\"type\":\"stats\",\"queued\":"<<jobs->size()<<",\"active\":"<<stats->active
+			    <<",\"served\":"<<stats->served<<",\"mean_queue_ms\":"
+			    <<(stats->served == 0 ? 0 : stats->queued_total / stats->served * 1000)
+			    <<",\"max_queue_ms\":"<<stats->queued_max * 1000;
+		}
+		if(options->cache != NULL)
+			line<<",\"cache_hits\":"<<options->cache->hit_count()
+			    <<",\"cache_misses\":"<<options->cache->miss_count();
+		line<<"}";
+		client->send_line(line.str());
+		return;
+	}
+	service_job job;
+	job.id = -1;
+	double milliseconds = 0;
+	const char* error = NULL;
+	if(command != "SOLVE")	error = "unknown command";
+	else if(!(in>>job.id>>job.seed>>milliseconds) || milliseconds < 0)	error = "bad request";
+	else{
+		string tiles;
+		getline(in, tiles);
+		job.count = read_tiles(tiles, job.tiles);
+		error = job.count < 0 ? "unreadable tiles" : check_board(job.tiles, job.count);
+	}
+	if(error != NULL){
+		ostringstream line;
+		line<<"{\"type\":\"error\",\"id\":"<<job.id<<",\"error\":\""<<error<<"\"}";
+		client->send_line(line.str());
+		return;
+	}
+	job.deadline = milliseconds / 1000;
+	job.received = chrono::steady_clock::now();
+	job.client = client;
+	//waits while the queue is full, holding the rest of this client's requests back
+	jobs->push(job);
+}
 
-		//step three: expand (only sometimes, when leaf node is visited)
-				current->expand();
-				for(int i = 0; i < 4; i++){
-					//choosing first valid child
-					if(current->children[i].valid)
-						break;
-				}
+//reads a connection's requests a line at a time until the client closes it
+void service_reader(shared_ptr<service_connection> client, bounded_queue<service_job>* jobs,
+		    service_stats* stats, const search_options* options){
+	string buffer;
+	char chunk[4096];
+	bool done = false;
+	while(!done){
+		size_t end;
+		while((end = buffer.find('\n')) == string::npos){
+			ssize_t n = recv(client->fd, chunk, sizeof(chunk), 0);
+			if(n < 0 && errno == EINTR)	continue;
+			if(n <= 0){
+				//a last line without a newline still counts
+				done = true;
+				end = buffer.size();
+				break;
 			}
-			//now current points to a valid leaf node ready for random walk
-
-		//step three and first half of step four: random walk and backpropagate back to leaf
-			double r_val = (random_walk(RANDOM_WALK_ITERATIONS, current->state)
-				       /RANDOM_WALK_ITERATIONS);
+			buffer.append(chunk, n);
+		}
+		service_request(buffer.substr(0, end), client, jobs, stats, options);
+		buffer.erase(0, end + 1);
+	}
+}
 
-			current->total_val += r_val;
+//the socket removed when the service is stopped
+static const char* service_path = NULL;
 
-		//step four finished: backpropagate values up the tree to the root
-			while(current->parent != NULL){
-				//increment visits
-				current->visits++;
-				//add on total value
-				current->parent->total_val += current->total_val;
-				//update current pointer
-				current = current->parent;
-			}
-			//finally, update the number of visits at the root
-			current->visits++;
-			return;	
-		}
+void service_stop(int){
+	unlink(service_path);
+	_exit(0);
+}
 
-		//simple method which selects a child based on maximum UCB1
-		//for ties, the first tied child is picked
-		int pick_child(){
-			if(leaf)	return -1;
-			double ucb1_score = 0;
-                        double max_val = -1;
-                        int max_index = -1;
-                        for(int i = 0; i < 4; i++){
-                                //only computing valid children
-                                if(children[i].valid){
-	                                //computing ucb1 for each child using current nodes visits
-	                                ucb1_score = children[i].UCB1();
-	                                //keeping track of maximum ucb1 and which child it was
-	                                if(ucb1_score > max_val){
-	                                        max_val = ucb1_score;
-	                                        max_index = i;
-	                                }
-				}
-                        }
-			return max_index;
-		}
-		//method called on root to decide a move and delete rest of tree
-		char pick_move(){
-			if(leaf)	return 'Z';
-			int index = pick_child();
-			return map[index];
-		}
-};
+int serve(const char* path, const search_options& options, int workers, int max_moves){
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path)){
+		cout<<"SOCKET PATH "<<path<<" IS TOO LONG. EXITING."<<endl;
+		return 1;
+	}
+	strcpy(address.sun_path, path);
+	//a socket left behind by a service that was not stopped cleanly
+	struct stat info;
+	if(lstat(path, &info) == 0 && S_ISSOCK(info.st_mode))	unlink(path);
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0
+	   || listen(listener, SOMAXCONN) != 0){
+		cout<<"COULD NOT LISTEN ON "<<path<<": "<<strerror(errno)<<". EXITING."<<endl;
+		if(listener >= 0)	close(listener);
+		return 1;
+	}
+	service_path = path;
+	signal(SIGINT, service_stop);
+	signal(SIGTERM, service_stop);
+	bounded_queue<service_job> jobs(workers * 4);
+	service_stats stats;
+	vector<thread> pool;
+	for(int w = 0; w < workers; w++)
+		pool.push_back(thread(service_worker, &jobs, &options, max_moves, &stats));
+	cout<<"SERVING ON "<<path<<" WITH "<<workers<<" WORKERS"<<endl;
+	while(true){
+		int fd = accept(listener, NULL, NULL);
+		if(fd < 0 && errno == EINTR)	continue;
+		if(fd < 0)	break;
+		thread(service_reader, make_shared<service_connection>(fd), &jobs, &stats, &options).detach();
+	}
+	cout<<"COULD NOT ACCEPT ON "<<path<<": "<<strerror(errno)<<". EXITING."<<endl;
+	jobs.close();
+	for(size_t w = 0; w < pool.size(); w++)	pool[w].join();
+	close(listener);
+	unlink(path);
+	return 1;
+}
 
-int main(){
-	bool display;
-	int start[16];
-	//input reading
-	//first the puzzle
-	for(int i = 0; i < 16; i++)
-		cin>>start[i];
-	//now reading y or not for display while searching
-	char letter;
-	cin>>letter;
-	if(letter == 'y' || letter == 'Y')	display = true;
-	else					display = false;
-	//now checking if rand is seeded or not
-	cin>>letter;
-	if(letter == 'n' || letter == 'N')	srand(time(NULL));
-	else					srand(letter);
-	fifteen_puzzle p(start);
+/*	Play function:
+	solves one board of puzzle type P, read by main, making a move after every
+	search until the goal is reached, or reports on thread scaling instead.
+	The search can be warm started from a tree checkpoint, and the trees can be
+	checkpointed after every search, before the move is made. With a position
+	cache, boards it is confident about are moved on from without a search.
+*/
+template <class P>
+int play(const search_options& options, int* start, bool display, uint64_t seed,
+	 double scaling, bool summaries, const char* load_tree, const char* save_tree){
+	P p(start);
 	//Node root;
-	fifteen_puzzle game_board(p);
+	P game_board(p);
+	if(scaling > 0){
+		int max_threads = thread::hardware_concurrency();
+		if(options.threads > max_threads)	max_threads = options.threads;
+		if(max_threads < 1)	max_threads = 1;
+		scaling_report(options, game_board, seed, scaling, max_threads);
+		return 0;
+	}
 	/*	Main loop:
 		Algorithm deliberates/updates values then makes a move
 		stops when goal is reached
 	*/
 	int j = 0;
+	//totals over every move's search
+	solve_result total;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	//the roots are kept between moves, so each search builds on the last
+	tree_search<P>* search = make_search(options, seed, game_board);
+	if(load_tree != NULL){
+		//the file is only needed while the nodes are being built
+		checkpoint_file file;
+		const char* error = file.load(load_tree);
+		if(error == NULL && (file.rows() != P::ROWS || file.columns() != P::COLUMNS))
+			error = "checkpoint is for another puzzle size";
+		size_t loaded = 0;
+		if(error == NULL)	error = search->load(file, game_board, loaded);
+		if(error != NULL){
+			cout<<"COULD NOT LOAD TREE "<<load_tree<<": "<<error<<". EXITING."<<endl;
+			delete search;
+			return 1;
+		}
+		if(loaded > 0)	cout<<"LOADED "<<loaded<<" NODES FROM "<<load_tree<<endl;
+		else		cout<<"NO TREE IN "<<load_tree<<" HOLDS THIS BOARD, STARTING FRESH"<<endl;
+	}
+	position_cache* cache = options.cache;
+	//the same environment generator as solve(), so a seed plays the same game
+	xoshiro256 environment(seed ^ 0xD1B54A32D192ED03ULL);
 	while(!game_board.goal_test()){
-		Node root(game_board);
-		//loops through a set iteration of mcts before making a decision
-		//number of iterations is subject to change
-		for(int i = 0; i < MCTS_ITERATIONS; i++){
-			root.mcts();
+		search_report report = search_report();
+		char move;
+		int cached = cache == NULL ? -1 : cache->lookup(game_board);
+		if(cached >= 0){
+			//a board decided with confidence before is not searched again
+			move = map[cached];
+			report.stop = "cache";
+			total.moves++;
+			total.cached++;
 		}
-		//after sufficiently exploring, the best child is chosen
-		game_board.swap(root.pick_move());
+		else{
+			//searches on every thread until one of the limits is reached
+			report = search->search(options.limits);
+			total.add(report);
+			if(save_tree != NULL){
+				const char* error = search->save(save_tree);
+				if(error != NULL)	cout<<"COULD NOT SAVE TREE TO "<<save_tree<<": "<<error<<endl;
+			}
+			//after sufficiently exploring, the best child is chosen
+			move = search->pick_move();
+			if(cache != NULL)	cache_decision(*cache, *search, game_board);
+		}
+		game_board.swap(move, environment);
+		//keeping the part of each tree that matches wherever the move landed
+		bool reused = search->reroot(game_board);
+		//updating the expansion and memory tallies from the arenas
+		expanded = search->expansions();
+		memory = search->peak_bytes();
+		if(summaries)	print_move_summary(cout, j, move, report);
 		if(display){
-			cout<<"MAIN LOOP ITERATION "<<j++<<endl;
-			cout<<"DONE DELIBERATING, CHOSE TO MOVE "<<root.pick_move()<<endl;
+			cout<<"MAIN LOOP ITERATION "<<j<<endl;
+			cout<<"DONE DELIBERATING, CHOSE TO MOVE "<<move<<endl;
+			if(cached >= 0)	cout<<"MOVE TAKEN FROM THE POSITION CACHE"<<endl;
+			else	cout<<"SEARCHED "<<report.iterations<<" ITERATIONS AND "<<report.rollouts
+			    <<" ROLLOUTS IN "<<report.seconds * 1000<<" MS, STOPPED BY "
+			    <<report.stop<<endl;
+			if(report.evicted > 0)	cout<<"EVICTED "<<report.evicted<<" NODES TO STAY UNDER THE BUDGET"<<endl;
+			if(reused)	cout<<"KEPT "<<search->size()<<" NODES FOR THE NEXT SEARCH"<<endl;
 			cout<<"PRINTING BOARD"<<endl;
 			game_board.print();
 		}
+		j++;
 	}
+	total.solved = true;
+	total.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	if(summaries)	print_solve_summary(cout, total);
 	cout<<"GOAL FOUND"<<endl;
-	
+	cout<<"NODES EXPANDED: "<<expanded<<endl;
+	cout<<"SEARCHED "<<total.iterations<<" ITERATIONS AND "<<total.rollouts<<" ROLLOUTS OVER "
+	    <<total.moves<<" MOVES"<<endl;
+	cout<<"PEAK ARENA USAGE: "<<(size_t)memory<<" BYTES ("<<search->peak_nodes()<<" NODES)"<<endl;
+	if(options.node_budget > 0)
+		cout<<"NODE BUDGET: "<<options.node_budget<<" NODES, "<<total.evicted<<" EVICTED"<<endl;
+	double hit_rate = search->table_probes() == 0 ? 0
+			: (double)search->table_hits() / search->table_probes();
+	cout<<"TRANSPOSITION TABLE: "<<search->table_hits()<<" HITS OVER "<<search->table_probes()
+	    <<" PROBES ("<<hit_rate * 100<<"%), "<<search->table_replacements()
+	    <<" REPLACEMENTS"<<endl;
+	if(cache != NULL){
+		uint64_t lookups = cache->hit_count() + cache->miss_count();
+		cout<<"POSITION CACHE: "<<cache->hit_count()<<" HITS OVER "<<lookups<<" LOOKUPS ("
+		    <<(lookups == 0 ? 0 : (double)cache->hit_count() / lookups * 100)<<"%), "
+		    <<cache->store_count()<<" STORES, "<<cache->filled()<<" OF "<<cache->capacity()
+		    <<" SLOTS FILLED"<<endl;
+	}
+	delete search;
+
 	return 0;
 }
+
+int main(int argc, char** argv){
+	//command line options
+	//	--threads N	number of search threads
+	//	--replicas N	grow N independent trees in root mode, spread
+	//			over the threads, one per thread by default
+	//	--parallel MODE	root for a separate tree per thread (the default),
+	//			tree for one tree shared by every thread
+	//	--batch K	run K walks from every leaf with the batched kernel
+	//	--scaling MS	report decision quality against thread count with a
+	//			budget of MS milliseconds per decision, then exit
+	//	--iterations N	search N iterations per tree per move
+	//	--deadline MS	search at most MS milliseconds per move
+	//	--nodes N	stop a move's search once the trees hold N nodes
+	//	--early-stop	stop once the chosen move can no longer change
+	//	--node-budget N	keep the trees under N nodes by evicting their
+	//			least visited subtrees
+	//	--rollout-steps N	take N steps in every walk
+	//	--rollout MODE	sampled for walks scored by their successful moves
+	//			(the default), expected for walks scored by the
+	//			expected value of every step
+	//	--policy NAME	how sampled walks pick moves: retry (the default),
+	//			uniform, no-backtrack or greedy, see policy.h
+	//	--epsilon E	chance the greedy policy picks at random
+	//	--stats		print a line of JSON for every move and for the solve
+	//	--solve-file PATH	solve every board in PATH, - for standard input,
+	//			one line of 9, 16 or 25 tiles per board
+	//	--serve PATH	solve boards sent over a Unix domain socket at PATH
+	//			until killed, see the solver service above
+	//	--workers N	boards solved at once by --solve-file or --serve
+	//	--format F	csv (the default) or ndjson results for --solve-file
+	//	--max-moves N	moves allowed per board by --solve-file or --serve
+	//	--seed N	seed in place of the input's seed letter, and for
+	//			--solve-file, board n using N plus n
+	//	--load-tree PATH	warm start from the tree checkpoint in PATH
+	//	--save-tree PATH	checkpoint the trees to PATH after every search
+	//	--pdb PATH	score fifteen puzzle boards with the pattern
+	//			databases in PATH, built by pdbgen
+	//	--cache PATH	play boards already decided with confidence from
+	//			the position cache in PATH, made if missing, and
+	//			store every search's decision in it
+	//	--cache-entries N	slots in a newly made position cache
+	//	--cache-visits N	visits a cached move needs to be played
+	//with a deadline or node budget and no iteration count, the
+	//iterations per move are unlimited
+	search_options options;
+	double scaling = 0;
+	bool counted = false;
+	bool summaries = false;
+	const char* solve_file = NULL;
+	const char* serve_path = NULL;
+	int workers = thread::hardware_concurrency();
+	bool csv = true;
+	int max_moves = BATCH_MAX_MOVES;
+	uint64_t batch_seed = 1;
+	bool seeded = false;
+	const char* pdb_file = NULL;
+	const char* load_tree = NULL;
+	const char* save_tree = NULL;
+	const char* cache_file = NULL;
+	size_t cache_entries = CACHE_ENTRIES;
+	int cache_visits = CACHE_MIN_VISITS;
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--replicas") == 0 && i + 1 < argc)
+			options.replicas = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--parallel") == 0 && i + 1 < argc
+			&& (strcmp(argv[i + 1], "root") == 0 || strcmp(argv[i + 1], "tree") == 0))
+			options.mode = argv[++i];
+		else if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			options.batch = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--scaling") == 0 && i + 1 < argc)
+			scaling = atof(argv[++i]) / 1000;
+		else if(strcmp(argv[i], "--iterations") == 0 && i + 1 < argc){
+			options.limits.iterations = atoi(argv[++i]);
+			counted = true;
+		}
+		else if(strcmp(argv[i], "--deadline") == 0 && i + 1 < argc)
+			options.limits.seconds = atof(argv[++i]) / 1000;
+		else if(strcmp(argv[i], "--nodes") == 0 && i + 1 < argc)
+			options.limits.nodes = atol(argv[++i]);
+		else if(strcmp(argv[i], "--early-stop") == 0)
+			options.limits.early_stop = true;
+		else if(strcmp(argv[i], "--node-budget") == 0 && i + 1 < argc)
+			options.node_budget = atol(argv[++i]);
+		else if(strcmp(argv[i], "--rollout-steps") == 0 && i + 1 < argc)
+			options.rollout_steps = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--rollout") == 0 && i + 1 < argc
+			&& (strcmp(argv[i + 1], "sampled") == 0 || strcmp(argv[i + 1], "expected") == 0))
+			options.expected = strcmp(argv[++i], "expected") == 0;
+		else if(strcmp(argv[i], "--policy") == 0 && i + 1 < argc && policy_index(argv[i + 1]) >= 0)
+			options.policy = policy_index(argv[++i]);
+		else if(strcmp(argv[i], "--epsilon") == 0 && i + 1 < argc)
+			options.epsilon = atof(argv[++i]);
+		else if(strcmp(argv[i], "--stats") == 0)
+			summaries = true;
+		else if(strcmp(argv[i], "--solve-file") == 0 && i + 1 < argc)
+			solve_file = argv[++i];
+		else if(strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+			serve_path = argv[++i];
+		else if(strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			workers = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc
+			&& (strcmp(argv[i + 1], "csv") == 0 || strcmp(argv[i + 1], "ndjson") == 0))
+			csv = strcmp(argv[++i], "csv") == 0;
+		else if(strcmp(argv[i], "--max-moves") == 0 && i + 1 < argc)
+			max_moves = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc){
+			batch_seed = strtoull(argv[++i], NULL, 10);
+			seeded = true;
+		}
+		else if(strcmp(argv[i], "--pdb") == 0 && i + 1 < argc)
+			pdb_file = argv[++i];
+		else if(strcmp(argv[i], "--load-tree") == 0 && i + 1 < argc)
+			load_tree = argv[++i];
+		else if(strcmp(argv[i], "--save-tree") == 0 && i + 1 < argc)
+			save_tree = argv[++i];
+		else if(strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+			cache_file = argv[++i];
+		else if(strcmp(argv[i], "--cache-entries") == 0 && i + 1 < argc)
+			cache_entries = atol(argv[++i]);
+		else if(strcmp(argv[i], "--cache-visits") == 0 && i + 1 < argc)
+			cache_visits = atoi(argv[++i]);
+		else{
+			cout<<"usage: "<<argv[0]<<" [--threads N] [--replicas N] [--parallel root|tree] [--batch K]"
+			    <<" [--scaling MS] [--iterations N] [--deadline MS] [--nodes N]"
+			    <<" [--early-stop] [--node-budget N] [--rollout-steps N] [--rollout sampled|expected]"
+			    <<" [--policy retry|uniform|no-backtrack|greedy] [--epsilon E] [--stats]"
+			    <<" [--solve-file PATH|- [--workers N] [--format csv|ndjson]"
+			    <<" [--max-moves N] [--seed N]] [--serve PATH [--workers N] [--max-moves N]]"
+			    <<" [--pdb PATH]"
+			    <<" [--load-tree PATH] [--save-tree PATH]"
+			    <<" [--cache PATH [--cache-entries N] [--cache-visits N]] < input"<<endl;
+			return 1;
+		}
+	}
+	if(options.threads < 1)	options.threads = 1;
+	if(options.replicas < 0)	options.replicas = 0;
+	if(options.batch < 1)	options.batch = 1;
+	if(options.batch > MAX_BATCH)	options.batch = MAX_BATCH;
+	if(options.rollout_steps < 1)	options.rollout_steps = 1;
+	if(options.limits.iterations < 1)	options.limits.iterations = 1;
+	if(options.limits.seconds < 0)	options.limits.seconds = 0;
+	if(!counted && (options.limits.seconds > 0 || options.limits.nodes > 0))
+		options.limits.iterations = INT32_MAX;
+	//the databases stay mapped until the program exits
+	pattern_database pdb;
+	if(pdb_file != NULL){
+		const char* error = pdb.load(pdb_file);
+		if(error != NULL){
+			cout<<"COULD NOT LOAD PATTERN DATABASE "<<pdb_file<<": "<<error<<". EXITING."<<endl;
+			return 1;
+		}
+		options.pdb = &pdb;
+	}
+	//as is the position cache, whose stores reach the file as they are made
+	position_cache cache;
+	if(cache_file != NULL){
+		const char* error = cache.load(cache_file, cache_entries);
+		if(error != NULL){
+			cout<<"COULD NOT OPEN POSITION CACHE "<<cache_file<<": "<<error<<". EXITING."<<endl;
+			return 1;
+		}
+		if(cache_visits < 1)	cache_visits = 1;
+		cache.set_confidence(cache_visits, CACHE_MIN_SHARE);
+		options.cache = &cache;
+	}
+	if(workers < 1)	workers = 1;
+	if(max_moves < 1)	max_moves = 1;
+	if(serve_path != NULL)	return serve(serve_path, options, workers, max_moves);
+	if(solve_file != NULL){
+		if(strcmp(solve_file, "-") == 0){
+			batch_solve(cin, options, workers, batch_seed, max_moves, csv);
+			return 0;
+		}
+		ifstream file(solve_file);
+		if(!file){
+			cout<<"COULD NOT OPEN "<<solve_file<<". EXITING."<<endl;
+			return 1;
+		}
+		batch_solve(file, options, workers, batch_seed, max_moves, csv);
+		return 0;
+	}
+	bool display;
+	int start[MAX_TILES];
+	//input reading
+	//first the puzzle, on a line of its own, its size given by its number of tiles
+	string line;
+	while(getline(cin, line) && line.find_first_not_of(" \t\r") == string::npos);
+	int count = read_tiles(line, start);
+	if(count != 9 && count != 16 && count != 25){
+		cout<<"PUZZLE INPUT MUST BE 9, 16 OR 25 TILES ON ONE LINE. EXITING."<<endl;
+		return 1;
+	}
+	//now reading y or not for display while searching
+	char letter;
+	cin>>letter;
+	if(letter == 'y' || letter == 'Y')	display = true;
+	else					display = false;
+	//now checking if rand is seeded or not, --seed taking the letter's place
+	//the search's and the moves' own generators are seeded the same way
+	cin>>letter;
+	uint64_t seed;
+	if(seeded)				seed = batch_seed;
+	else if(letter == 'n' || letter == 'N'){
+		seed = time(NULL);
+		//printed so the game can be played again with --seed
+		cout<<"SEEDED WITH "<<seed<<endl;
+	}
+	else					seed = letter;
+	srand(seed);
+	if(options.pdb != NULL && count != 16)
+		cout<<"PATTERN DATABASES ONLY COVER THE FIFTEEN PUZZLE, USING MANHATTEN DISTANCE"<<endl;
+	if(count == 9)
+		return play<eight_puzzle>(options, start, display, seed, scaling, summaries,
+					  load_tree, save_tree);
+	if(count == 25)
+		return play<twenty_four_puzzle>(options, start, display, seed, scaling, summaries,
+						load_tree, save_tree);
+	return play<fifteen_puzzle>(options, start, display, seed, scaling, summaries,
+				    load_tree, save_tree);
+}
@@ -0,0 +1,1862 @@
+
+/* 	mcts.h written by Conor Harrigan
+	This file implements the monte-carlo tree search algorithm
+	in order to solve a fifteen puzzle, working alongside puzzlefile.h.
+	The program itself is in mcts.cpp, and the benchmarks in bench.cpp.
+
+	The algorithm has four steps:
+		1. Traversing
+			The algorithm traverses over already-explored elements
+			of the tree using UCB1 criteria, defined in the UCB1 method.
+			After following these criteria to a leaf node, the second step starts
+		2. Expansion
+			Once a leaf node is reached, it has either been unvisited or not.
+			If unvisited, step three starts. If visited, then the node is
+			expanded, opening its possible actions to selection. In this 
+			implementation, there are four actions that any node can take
+			(although on occasion fewer, as the boundaries of the puzzle have
+			fewer valid moves). A child node is only started once selection
+			first descends into it. After expanding, step three begins.
+		3. Random Walk
+			Now at a leaf node, the algorithm begins to randomly select moves 
+			and follow down a random path. In this implementation the criteria
+			for stopping the random walk is a set limit of iterations.
+		4. Backpropagate
+			Now at some deep internal node, all the estimated values achieved at each 
+			node are computed and set back up the chain to the starting leaf node
+			and eventually the root. This is implemented in a two step process with
+			the first step being the temporary  random walk nodes, done 
+			recursively back to the leaf node, and the second step being the nodes 
+			on the tree back to the root.
+*/
+
+#ifndef MCTS_H
+#define MCTS_H
+
+#include "puzzlefile.h"
+#include "arena.h"
+#include "table.h"
+#include "batch.h"
+#include "stats.h"
+#include "pdb.h"
+#include "policy.h"
+#include "checkpoint.h"
+#include "cache.h"
+#include <iostream>
+#include <ctime>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <new>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+
+//defaults for the length of a walk and the iterations searched per move,
+//both of which can be changed on the command line
+#define RANDOM_WALK_ITERATIONS 200
+#define MCTS_ITERATIONS 20
+#define C_CONST 2.0
+//visit counts below which the terms of UCB1 are looked up rather than computed
+#define UCB_TABLE 1024
+#define TABLE_ENTRIES (1 << 16)
+//share of the node budget a tree is cut back to once it reaches the budget,
+//in quarters, so that eviction is not needed again at the very next expansion
+#define EVICTION_QUARTERS 3
+//iterations a search runs before it may stop early, so a move is never
+//decided on the few visits of a search that has barely started
+#define EARLY_STOP_ITERATIONS 16
+
+using namespace std;
+
+/*	Child blocks:
+	the children of an expanded node, one array per field with an entry per
+	move index, so that picking a child reads the four siblings side by side
+	from one block. A block is all the tree keeps of the nodes below the root:
+	a child's visits and value are its entries in its parent's block, and its
+	own children are in the block its entry points to, NULL until the child is
+	expanded. Its board is its parent's board after its move, worked out again
+	on the way down whenever it is needed, so selection goes from block to
+	block and never reads anything else. A child is started, its value set to
+	its board's heuristic, the first time selection descends into it, and
+	until then it is nothing more than its move index. Blocks are 96 bytes
+	aligned to 32, so each one spans exactly two cache lines.
+*/
+template <class P>
+struct alignas(32) child_block{
+	atomic<int> visits[4];
+	atomic<double> values[4];
+	//searches currently passing through each child, at most one per thread
+	atomic<int16_t> virtual_loss[4];
+	//bit m set when move index m is valid
+	int valid;
+	//bit m set once child m has been started
+	atomic<int> started;
+	//each child's own child block, NULL until the child is expanded
+	atomic<child_block*> blocks[4];
+	child_block(int valid_moves){
+		for(int i = 0; i < 4; i++){
+			visits[i] = 0;
+			values[i] = 0;
+			virtual_loss[i] = 0;
+			blocks[i] = NULL;
+		}
+		valid = valid_moves;
+		started = 0;
+	}
+};
+
+/*node_arena class:
+	the storage of one search's tree below its root, one child block at a
+	time, along with a count of the nodes those blocks hold, every started
+	child being one node.
+*/
+template <class P>
+class node_arena{
+	private:
+		block_arena<child_block<P>, 1> blocks;
+		size_t count;
+		size_t peak;
+	public:
+		node_arena(){
+			count = 0;
+			peak = 0;
+		}
+		child_block<P>* alloc_block(){
+			return blocks.alloc_block();
+		}
+		void free_block(child_block<P>* block){
+			blocks.free_block(block);
+		}
+		void add_nodes(size_t nodes){
+			count += nodes;
+			if(count > peak)	peak = count;
+		}
+		void drop_nodes(size_t nodes){
+			count -= nodes < count ? nodes : count;
+		}
+		void reset(){
+			blocks.reset();
+			count = 0;
+		}
+		void swap(node_arena& other){
+			blocks.swap(other.blocks);
+			std::swap(count, other.count);
+			std::swap(peak, other.peak);
+		}
+		//nodes held since the last reset, and the most ever held at once
+		size_t nodes() const{
+			return count;
+		}
+		size_t peak_nodes() const{
+			return peak;
+		}
+		size_t peak_bytes() const{
+			return blocks.peak_bytes();
+		}
+};
+
+//one step of a descent: the child block passed through, the move index taken
+//and the board it led to
+template <class P>
+struct path_step{
+	child_block<P>* block;
+	int index;
+	P board;
+};
+
+/*	UCB1 tables:
+	the reciprocal and reciprocal square root of a child's visits and C times
+	the square root of the log of its parent's, for the small counts most
+	nodes have, so a selection step costs multiplies and no divisions, logs
+	or square roots. The reciprocals of 0 are 0, an unvisited child being
+	scored separately.
+*/
+struct ucb_tables{
+	double inverse[UCB_TABLE];
+	double inverse_root[UCB_TABLE];
+	double exploration[UCB_TABLE];
+	ucb_tables(){
+		for(int n = 0; n < UCB_TABLE; n++){
+			inverse[n] = n == 0 ? 0 : 1.0 / n;
+			inverse_root[n] = n == 0 ? 0 : 1.0 / sqrt((double)n);
+			exploration[n] = n == 0 ? 0 : C_CONST * sqrt(log((double)n));
+		}
+	}
+};
+inline const ucb_tables ucb_lookup;
+
+inline double ucb_inverse(int n){
+	return n < UCB_TABLE ? ucb_lookup.inverse[n] : 1.0 / n;
+}
+inline double ucb_inverse_root(int n){
+	return n < UCB_TABLE ? ucb_lookup.inverse_root[n] : 1.0 / sqrt((double)n);
+}
+inline double ucb_exploration(int N){
+	return N < UCB_TABLE ? ucb_lookup.exploration[N] : C_CONST * sqrt(log((double)N));
+}
+//avg value + C*sqrt(lnN/n) for a child with total value, n visits and a parent
+//whose exploration term is given, the unvisited scoring highest of all
+inline double ucb_score(double value, int n, double exploration){
+	double score = value * ucb_inverse(n) + exploration * ucb_inverse_root(n);
+	return n == 0 ? DBL_MAX : score;
+}
+
+/*	Search limits:
+	when the search for a single move stops. Whichever limit is reached first
+	ends the search: the iterations per thread, the wall clock budget, or the
+	number of nodes in the tree. With early stopping on, the search also ends
+	as soon as the most visited root child is further ahead of the runner up
+	than the iterations left could make up, since the move can no longer change.
+	Only visits made by the search under way count towards the lead, and it
+	always runs at least EARLY_STOP_ITERATIONS iterations first.
+*/
+struct search_limits{
+	int iterations;
+	//seconds per move, 0 for no deadline
+	double seconds;
+	//nodes in the tree, split evenly over the threads, 0 for no limit
+	size_t nodes;
+	bool early_stop;
+	search_limits(){
+		iterations = MCTS_ITERATIONS;
+		seconds = 0;
+		nodes = 0;
+		early_stop = false;
+	}
+};
+
+/*	Search report:
+	what the search for a single move actually did, and which limit stopped it
+*/
+struct search_report{
+	int iterations;
+	long long rollouts;
+	int expansions;
+	double seconds;
+	const char* stop;
+	//nodes evicted to stay under the node budget
+	long long evicted;
+	//counters and timers for this move alone
+	search_stats stats;
+};
+
+/*	Search options:
+	settings chosen on the command line that every search and every one of
+	its contexts is built from
+*/
+struct search_options{
+	//number of search threads, and "root" for a separate tree per thread
+	//or "tree" for one tree shared by every thread
+	int threads;
+	const char* mode;
+	//independent trees the root parallel search grows, spread over its
+	//threads, 0 for one per thread
+	int replicas;
+	//walks run from every leaf, more than one using the batched kernel
+	int batch;
+	//steps in every walk, and whether walks are scored by their expected
+	//value (expected_walk) rather than by sampling every move (sampled_walk)
+	int rollout_steps;
+	bool expected;
+	//pattern database scoring fifteen puzzle boards in place of the
+	//manhatten sum, NULL for the puzzle's own heuristic
+	const pattern_database* pdb;
+	//how sampled walks pick their moves, one of the POLICY constants,
+	//and how often the greedy policy picks at random instead
+	int policy;
+	double epsilon;
+	//most nodes the trees may hold, split evenly over them, before the least
+	//visited subtrees are evicted to make room, 0 for no budget
+	size_t node_budget;
+	//moves already decided with confidence, played without searching
+	//before every move's search and filled after it, NULL for none
+	position_cache* cache;
+	search_limits limits;
+	search_options(){
+		threads = 1;
+		mode = "root";
+		replicas = 0;
+		batch = 1;
+		rollout_steps = RANDOM_WALK_ITERATIONS;
+		expected = false;
+		pdb = NULL;
+		policy = POLICY_RETRY;
+		epsilon = GREEDY_EPSILON;
+		node_budget = 0;
+		cache = NULL;
+	}
+};
+
+/*	Search context:
+	state owned by a single search instance and threaded through the tree
+	as it is searched: the search's own random number generator, and the
+	arena that every child block of the search's tree is carved from.
+	Before every iteration the generator is replaced by the stream the
+	counter based generator gives for the move being searched, counted from
+	the start of the game, and the iteration.
+	The spare arena is where a subtree kept between moves is copied to
+	before the two arenas trade places. The transposition table, when there
+	is one, pools statistics for boards reached along different paths,
+	giving children started on a board seen before a prior on their value.
+	A context marked shared belongs to one of several threads searching the
+	same tree. A batch of more than one runs that many walks from every leaf
+	with the batched rollout kernel and backpropagates their mean. The pattern
+	database, when there is one, scores boards for the walks and for the
+	children of every expansion. The node budget is this context's share of
+	the search's budget. The path is the descent of the iteration under
+	way, kept for backpropagation. Contexts, like the rest of the search,
+	are built for one puzzle size P.
+*/
+template <class P>
+struct search_context{
+	xoshiro256 rng;
+	philox streams;
+	node_arena<P> arena;
+	node_arena<P> spare;
+	transposition_table<P>* table;
+	bool shared;
+	int batch;
+	int rollout_steps;
+	bool expected;
+	const pattern_database* pdb;
+	int policy;
+	double epsilon;
+	size_t node_budget;
+	//number of expansions made and walks run by this search, and the
+	//nodes evicted to stay under the budget
+	int expansions;
+	long long rollouts;
+	long long evicted;
+	//hot path counters and phase timers, empty when compiled out
+	search_stats stats;
+	vector<path_step<P>> path;
+	uint32_t move;
+	search_context(uint64_t seed, const search_options& options) : rng(seed), streams(seed){
+		move = 0;
+		table = NULL;
+		shared = false;
+		batch = options.batch;
+		rollout_steps = options.rollout_steps;
+		expected = options.expected;
+		pdb = options.pdb;
+		policy = options.policy;
+		epsilon = options.epsilon;
+		node_budget = options.node_budget;
+		expansions = 0;
+		rollouts = 0;
+		evicted = 0;
+	}
+	//starts the draws of the given iteration of this move's search
+	void begin_iteration(int iteration){
+		rng = streams.stream(move, iteration);
+	}
+	//reseeds both generators as if the context had just been built
+	void seed(uint64_t seed){
+		rng.seed(seed);
+		streams.seed(seed);
+		move = 0;
+	}
+};
+
+//adds to an atomic double, which has no fetch_add of its own before C++20
+inline void atomic_add(atomic<double>& a, double value){
+	double old = a.load(memory_order_relaxed);
+	while(!a.compare_exchange_weak(old, old + value, memory_order_relaxed));
+}
+
+/*      Random walk function
+                        This function plays moves on a single scratch puzzle that is
+                        not linked to any Node. It lets the rollout policy pick a move
+			and proceeds down the walk. I opted to make this a function and
+			not a method because the Node architecture is unnecessary as no
+			tree needs to be stored or used. The walk runs in place in a loop
+			and draws every random number from the searching instance's generator.
+			When given statistics to add to, it counts its steps and failures,
+			and when given a pattern database, it scores boards with it.
+		
+                        There are two possible failures in proceeding:
+                                1. move randomly selected was invalid
+                                2. move randomly selected was valid, but the valid move
+                                   nondeterministically failed
+                        In the first case the algorithm wont be punished since a smarter
+                        implementation could avoid this, and every policy but retry does
+                        However in the second case the whole iteration will fail, and miss out
+                        on the value provided had the move been successful, so the program will 
+                        learn from low-probalility moves that the expected value is lower
+*/
+template <class Policy, class P>
+inline double policy_walk(int iterations, P state, xoshiro256& rng, Policy& policy,
+			  [[maybe_unused]] search_stats* stats = NULL, const pattern_database* pdb = NULL){
+	double result = 0.0;
+	//last move that succeeded, for the policies that avoid undoing it
+	int previous = -1;
+	STAT(long long failures = 0;)
+	//one step per iteration, counting down to and including zero
+	for(int i = iterations; i >= 0; i--){
+		int move = policy.pick(state, previous, rng);
+		//now with a valid move, time to see if it was randomly successful
+		//if it was unsuccessful, miss out on this iteration of returns
+		if(!state.swap(map[move], rng)){
+			STAT(failures++;)
+			continue;
+		}
+		previous = move;
+		//swap was successful, add on the value of the new state
+		result += evaluate(state, pdb);
+	}
+	STAT(if(stats != NULL){
+		stats->rollout_steps += iterations + 1;
+		stats->swap_failures += failures;
+	})
+	return result;
+}
+//the original walk, rerolling invalid moves
+template <class P>
+inline double random_walk(int iterations, P state, xoshiro256& rng,
+			  search_stats* stats = NULL, const pattern_database* pdb = NULL){
+	retry_policy policy;
+	double result = policy_walk(iterations, state, rng, policy, stats, pdb);
+	STAT(if(stats != NULL)	stats->invalid_retries += policy.retries;)
+	return result;
+}
+//one walk with the context's policy
+template <class P>
+inline double sampled_walk(search_context<P>& ctx, const P& state){
+	switch(ctx.policy){
+		case POLICY_UNIFORM:{
+			uniform_policy policy;
+			return policy_walk(ctx.rollout_steps, state, ctx.rng, policy, &ctx.stats, ctx.pdb);
+		}
+		case POLICY_NO_BACKTRACK:{
+			no_backtrack_policy policy;
+			return policy_walk(ctx.rollout_steps, state, ctx.rng, policy, &ctx.stats, ctx.pdb);
+		}
+		case POLICY_GREEDY:{
+			greedy_policy policy(ctx.epsilon, ctx.pdb);
+			return policy_walk(ctx.rollout_steps, state, ctx.rng, policy, &ctx.stats, ctx.pdb);
+		}
+		default:
+			return random_walk(ctx.rollout_steps, state, ctx.rng, &ctx.stats, ctx.pdb);
+	}
+}
+
+/*	Expected walk function
+			Same walk as random_walk, but instead of scoring a step only when its
+			move happened to succeed, every step is scored with the value the step
+			is expected to add: the average over the legal moves of the move's
+			chance of success times the heuristic of the board it leads to. The
+			walk itself still moves on by rolling for the chosen move's success,
+			so the expected total is exactly that of random_walk, only without
+			the variance of the success rolls and move choices along the way.
+*/
+template <class P>
+inline double expected_walk(int iterations, P state, xoshiro256& rng,
+			    [[maybe_unused]] search_stats* stats = NULL, const pattern_database* pdb = NULL){
+	double result = 0.0;
+	int legal[4];
+	STAT(long long failures = 0;)
+	for(int i = iterations; i >= 0; i--){
+		int count = 0;
+		double expected = 0;
+		for(int m = 0; m < 4; m++){
+			if(!state.valid_swap(m))	continue;
+			legal[count++] = m;
+			expected += P::success_chance(state.blank(), m) * evaluate_after(state, m, pdb);
+		}
+		result += expected / count;
+		//moving on with one of the legal moves, picked uniformly as random_walk does
+		if(!state.swap(map[legal[rng.below(count)]], rng)){
+			STAT(failures++;)
+		}
+	}
+	STAT(if(stats != NULL){
+		stats->rollout_steps += iterations + 1;
+		stats->swap_failures += failures;
+	})
+	return result;
+}
+
+
+/*	Batched walks:
+	runs the context's batch of walks from one board, with the vectorized
+	kernel for the fifteen puzzle and one sampled_walk after another for the
+	sizes it was not written for, for boards scored by a pattern database, or
+	for the policies other than the uniform choice of legal moves the kernel
+	makes, returning the mean and variance of the walks.
+*/
+template <class P>
+rollout_stats batch_walk(search_context<P>& ctx, const P& state){
+	if constexpr(is_same<P, fifteen_puzzle>::value){
+		if(ctx.pdb == NULL && (ctx.policy == POLICY_RETRY || ctx.policy == POLICY_UNIFORM)){
+			rollout_batch batch;
+			return batch.walk(ctx.rollout_steps, state, ctx.batch, ctx.rng);
+		}
+	}
+	double total = 0;
+	double squares = 0;
+	for(int b = 0; b < ctx.batch; b++){
+		double value = sampled_walk(ctx, state);
+		total += value;
+		squares += value * value;
+	}
+	rollout_stats result;
+	result.mean = total / ctx.batch;
+	result.variance = ctx.batch > 1 ? (squares - total * result.mean) / (ctx.batch - 1) : 0;
+	if(result.variance < 0)	result.variance = 0;
+	return result;
+}
+
+/*	Node class:
+	This class is used by the monte carlo tree search and is the
+	implementation of the tree. Each node will typically have
+	four children, though nodes representing the "sides" of the puzzle
+	will have three, and the nodes representing the "corners" will have two.
+
+	A Node is the root of a tree, holding its board and statistics itself,
+	and every node below it lives in the child blocks laid out above: its
+	statistics as entries in its parent's block and its children in a block
+	of its own. Expanding a node gives it an empty block, opening its valid
+	moves to selection, and a child is started the first time selection
+	descends into it. Since a child that was never started was never
+	visited, it scores as high as any unvisited child in UCB1, so selection
+	goes the same way it would if every child had been started up front.
+
+	Visits, values and the block pointers are atomic so that several threads
+	can search one shared tree. A block is published with a single compare
+	and swap once it is built, so when two threads expand the same node the
+	one that loses hands its block back to its arena, and a child is started
+	only by the thread that sets its started bit.
+	Nodes hold a puzzle of type P, one of the sliding_puzzle sizes.
+*/
+template <class P>
+class Node{
+	private:
+		//the root's children, NULL until it is expanded. Blocks are owned by
+		//a search's arena and never freed on their own
+		atomic<child_block<P>*> block;
+		//tracking total value of the root (updated during backpropagation)
+		atomic<double> total_val;
+		//puzzle held within the root representing the state
+		P state;
+		//tracking number of times the root is visited (updated during backpropagation)
+		atomic<int> visits;
+		//searches currently passing through the root, counted as visits that
+		//scored nothing so that other threads are steered elsewhere
+		atomic<int16_t> virtual_loss;
+		//visits of each child when the search under way started, so that
+		//visits kept from earlier searches are left out of visit_gap
+		int searched[4];
+
+		//the valid moves from the root's board, in move index order
+		const int* moves() const{
+			return P::lookup.legal[state.blank()];
+		}
+		int move_count() const{
+			return P::lookup.legal_count[state.blank()];
+		}
+		//the valid moves from a board, as the bits of a child block's valid mask
+		static int valid_moves(const P& board){
+			int valid = 0;
+			for(int k = 0; k < P::lookup.legal_count[board.blank()]; k++)
+				valid |= 1 << P::lookup.legal[board.blank()][k];
+			return valid;
+		}
+		//nodes started in a block
+		static int started_count(child_block<P>* b){
+			return __builtin_popcount(b->started.load(memory_order_acquire));
+		}
+		/*gives the node whose block pointer is slot an empty block for the
+		  board, returning false without doing anything if another search got
+		  to the node first*/
+		static bool expand(atomic<child_block<P>*>& slot, const P& board, search_context<P>& ctx){
+			if(slot.load(memory_order_acquire) != NULL)	return false;
+			child_block<P>* b = ctx.arena.alloc_block();
+			new (b) child_block<P>(valid_moves(board));
+			child_block<P>* expected = NULL;
+			if(slot.compare_exchange_strong(expected, b, memory_order_acq_rel))	return true;
+			ctx.arena.free_block(b);
+			return false;
+		}
+		/*starts child index of block b, whose board is given, the first time
+		  any search descends into it. Its value starts at the board's heuristic,
+		  or, for a board already in the transposition table, at the average
+		  value gathered for it elsewhere in the tree. Only the value is taken
+		  as a prior: the table's visits were not made by this node, so they
+		  are left out of the visits that decide expansion and the move.*/
+		static void start(child_block<P>* b, int index, const P& board, search_context<P>& ctx){
+			int bit = 1 << index;
+			if(b->started.load(memory_order_acquire) & bit)	return;
+			if(b->started.fetch_or(bit, memory_order_acq_rel) & bit)	return;
+			ctx.arena.add_nodes(1);
+			const tt_entry<P>* e = ctx.table == NULL ? NULL : ctx.table->probe(board);
+			double prior = e != NULL && e->visits > 0 ? e->total_val / e->visits
+				     : evaluate(board, ctx.pdb);
+			atomic_add(b->values[index], prior);
+		}
+		/*simple method which selects a child out of a child block based on
+		  maximum UCB1, given the visits of the node the block belongs to, a
+		  child not started yet scoring as an unvisited one. The four siblings
+		  are scored in one pass with no branches on their statistics, invalid
+		  moves scoring below anything valid, and the highest is picked; for
+		  ties, the first tied child is picked*/
+		static int pick(child_block<P>* b, int parent_visits){
+			double exploration = ucb_exploration(parent_visits);
+			double score[4];
+			for(int i = 0; i < 4; i++){
+				int n = b->visits[i].load(memory_order_relaxed)
+				      + b->virtual_loss[i].load(memory_order_relaxed);
+				double ucb = ucb_score(b->values[i].load(memory_order_relaxed), n, exploration);
+				score[i] = (b->valid >> i) & 1 ? ucb : -DBL_MAX;
+			}
+			int best = 0;
+			for(int i = 1; i < 4; i++)
+				if(score[i] > score[best])	best = i;
+			return best;
+		}
+		//copies a block and every block below it into the arena, returning the copy
+		static child_block<P>* copy(child_block<P>* old, node_arena<P>& arena){
+			if(old == NULL)	return NULL;
+			child_block<P>* b = arena.alloc_block();
+			new (b) child_block<P>(old->valid);
+			b->started = old->started.load(memory_order_acquire);
+			arena.add_nodes(started_count(b));
+			for(int i = 0; i < 4; i++){
+				b->visits[i] = old->visits[i].load(memory_order_relaxed);
+				b->values[i] = old->values[i].load(memory_order_relaxed);
+				b->blocks[i] = copy(old->blocks[i].load(memory_order_acquire), arena);
+			}
+			return b;
+		}
+		//nodes in a block and every block below it
+		static int count(child_block<P>* b){
+			if(b == NULL)	return 0;
+			int result = started_count(b);
+			for(int i = 0; i < 4; i++)	result += count(b->blocks[i].load(memory_order_acquire));
+			return result;
+		}
+		/*drops the block at slot and every block below it, making the node
+		  it belongs to a leaf again with its visits and value kept, so it can
+		  be expanded anew later on. The blocks are handed back to the arena
+		  when given one, and only unlinked otherwise. Returns the nodes dropped.*/
+		static size_t release(atomic<child_block<P>*>& slot, node_arena<P>* arena){
+			child_block<P>* b = slot.load(memory_order_acquire);
+			if(b == NULL)	return 0;
+			size_t dropped = started_count(b);
+			for(int i = 0; i < 4; i++)	dropped += release(b->blocks[i], arena);
+			slot.store(NULL, memory_order_release);
+			if(arena != NULL){
+				arena->drop_nodes(started_count(b));
+				arena->free_block(b);
+			}
+			return dropped;
+		}
+		//an expanded node below the root that has children started, for eviction
+		struct eviction_candidate{
+			int visits;
+			atomic<child_block<P>*>* slot;
+			bool operator<(const eviction_candidate& other) const{
+				return visits < other.visits;
+			}
+		};
+		//adds every node below block b that has children started
+		static void collect_expanded(child_block<P>* b, vector<eviction_candidate>& nodes){
+			for(int i = 0; i < 4; i++){
+				child_block<P>* below = b->blocks[i].load(memory_order_acquire);
+				if(below == NULL)	continue;
+				collect_expanded(below, nodes);
+				if(started_count(below) > 0){
+					eviction_candidate c;
+					c.visits = b->visits[i].load(memory_order_relaxed);
+					c.slot = &b->blocks[i];
+					nodes.push_back(c);
+				}
+			}
+		}
+		/*rebuilds the block at slot for the node with the given board out of
+		  the count records of its tree, records[index] being the record the
+		  node was read from, taking a block from the arena. Children never
+		  visited are left to be started again when first descended into, as
+		  are records for moves that are not valid from the node's board.
+		  Children are always further on than their parent in breadth first
+		  order, and any that are not, or fall off the end, leave the node a leaf.
+		  Every child's board is worked out from the node's own, and returns
+		  false if a record does not hold that board, an invalid move's record
+		  holds anything but the empty board, or a record has negative visits,
+		  in which case the file is corrupt and the block is left half built.*/
+		static bool restore(atomic<child_block<P>*>& slot, const P& board, const checkpoint_node* records,
+				    uint64_t count, uint64_t index, node_arena<P>& arena){
+			uint64_t first = records[index].children;
+			if(first <= index || first + 4 > count)	return true;
+			child_block<P>* b = arena.alloc_block();
+			new (b) child_block<P>(valid_moves(board));
+			slot.store(b, memory_order_release);
+			for(int i = 0; i < 4; i++){
+				const checkpoint_node& r = records[first + i];
+				typename P::word packed = (typename P::word)r.board_high << 32 << 32 | r.board_low;
+				if(!((b->valid >> i) & 1)){
+					if(packed != 0)	return false;
+					continue;
+				}
+				P child = board.after(i);
+				if(!P::valid_packed(packed) || packed != child.packed() || r.visits < 0)
+					return false;
+				if(r.visits == 0 && r.children == 0)	continue;
+				b->started.fetch_or(1 << i, memory_order_relaxed);
+				b->visits[i] = r.visits;
+				b->values[i] = r.total_val;
+				arena.add_nodes(1);
+				if(!restore(b->blocks[i], child, records, count, first + i, arena))	return false;
+			}
+			return true;
+		}
+	public:
+		//method to check if a move is valid from the node's board
+		bool hasMove(int index){
+			return state.valid_swap(map[index]);
+		}
+		//method to check if a child has been started
+		bool hasChild(int index){
+			child_block<P>* b = block.load(memory_order_acquire);
+			return b != NULL && ((b->started.load(memory_order_acquire) >> index) & 1);
+		}
+		//method to retrieve number of visits
+		int getVisits(){
+			return visits.load(memory_order_relaxed);
+		}
+		//method to retrieve total value
+		double getValue(){
+			return total_val.load(memory_order_relaxed);
+		}
+		//method to retrieve state
+		P getState(){
+			return state;
+		}
+		//constructor for root node, given a starting fifteen puzzle
+		Node(P p){
+			block = NULL;
+			visits = 0;
+			virtual_loss = 0;
+			total_val = p.heuristic();
+			state.copy(p);
+			begin_search();
+		}
+		//constructor for a root read back from a checkpoint record
+		Node(const checkpoint_node& r){
+			block = NULL;
+			state = P::unpacked((typename P::word)r.board_high << 32 << 32 | r.board_low);
+			total_val = r.total_val;
+			visits = r.visits;
+			virtual_loss = 0;
+			begin_search();
+		}
+		//copy constructor and assignment, which take a snapshot of the atomics
+		//and share the blocks below
+		Node(const Node& n){
+			*this = n;
+		}
+		Node& operator=(const Node& n){
+			block = n.block.load(memory_order_acquire);
+			total_val = n.total_val.load(memory_order_relaxed);
+			state.copy(n.state);
+			visits = n.visits.load(memory_order_relaxed);
+			virtual_loss = 0;
+			for(int i = 0; i < 4; i++)	searched[i] = n.searched[i];
+			return *this;
+		}
+		//copies every block of the tree into the arena, so the arena the tree
+		//was in can be reset
+		void copy_children(node_arena<P>& arena){
+			block = copy(block.load(memory_order_acquire), arena);
+		}
+		/*method called on the root after a real move has been made, to keep
+		  whatever part of the tree still describes the board. If the move failed
+		  the board is unchanged and the whole tree is kept. If the move succeeded
+		  onto a child that was started, that child becomes the root, its subtree is
+		  compacted into the spare arena and the arenas trade places, dropping its
+		  siblings. Otherwise a fresh root is started. Returns true when search work
+		  was kept.
+		*/
+		bool reroot(const P& board, search_context<P>& ctx){
+			if(state.equals(board))	return true;
+			child_block<P>* b = block.load(memory_order_acquire);
+			int kept = -1;
+			for(int i = 0; i < 4; i++){
+				if(hasChild(i) && state.after(i).equals(board)){
+					kept = i;
+					break;
+				}
+			}
+			if(kept < 0){
+				ctx.arena.reset();
+				*this = Node(board);
+				return false;
+			}
+			ctx.spare.reset();
+			visits = b->visits[kept].load(memory_order_relaxed);
+			total_val = b->values[kept].load(memory_order_relaxed);
+			virtual_loss = 0;
+			state.copy(board);
+			block = copy(b->blocks[kept].load(memory_order_acquire), ctx.spare);
+			ctx.arena.swap(ctx.spare);
+			return true;
+		}
+		//method to check if a Node is a goal node, using goal_test in puzzlefile
+		bool is_goal(){
+			if(state.goal_test())	return true;
+			return false;
+		}
+		//method to expand the root, giving it an empty child block that opens
+		//its moves to selection without starting any children
+		//returns false without doing anything if another search got to it first
+		bool expand(search_context<P>& ctx){
+			return expand(block, state, ctx);
+		}
+		//UCB1 of a child of the root, 0 if the root was never expanded
+		double UCB1(int index){
+			child_block<P>* b = block.load(memory_order_acquire);
+			if(b == NULL)	return 0;
+			int n = b->visits[index].load(memory_order_relaxed)
+			      + b->virtual_loss[index].load(memory_order_relaxed);
+			return ucb_score(b->values[index].load(memory_order_relaxed), n,
+					 ucb_exploration(getVisits() + virtual_loss.load(memory_order_relaxed)));
+		}
+		//method to check if the node has been expanded
+		bool isLeaf(){
+			return block.load(memory_order_acquire) == NULL;
+		}
+		//prints state and every child's state, as well as visits and total values
+		void print(){
+			cout<<"***********************"<<endl;
+			cout<<"Total Value:\t"<<getValue()<<endl;
+			cout<<"Num Visits:\t"<<getVisits()<<endl;
+			cout<<"Avg Value:\t";
+				if(getVisits() == 0)	cout<<"Infinity"<<endl;
+				else		cout<<getValue()/(double)getVisits()<<endl;
+			cout<<"Heuristic:\t"<<state.heuristic()<<endl;
+			state.print();
+			if(isLeaf()){
+				cout<<"******NO CHILDREN******"<<endl;
+				return;
+			}
+			cout<<"***PRINTING CHILDREN***"<<endl;
+			for(int i = 0; i < 4; i++){
+				if(!hasMove(i)){
+					cout<<"Skipped invalid child with move "<<map[i]<<endl;
+					continue;
+				}
+				if(!hasChild(i)){
+					cout<<"Skipped unvisited child with move "<<map[i]<<endl;
+					continue;
+				}
+				P child = state.after(i);
+				cout<<"MOVE: "<<map[i]<<endl;
+				cout<<"Total Value:\t"<<child_value(i)<<endl;
+				cout<<"Num Visits:\t"<<child_visits(i)<<endl;
+				cout<<"Avg Value:\t";
+					if(child_visits(i) == 0)	cout<<"Infinity"<<endl;
+					else 		cout<<child_value(i)/(double)child_visits(i)<<endl;
+				cout<<"UCB1 Score: \t"<<UCB1(i)<<endl;
+				cout<<"Heuristic:\t"<<child.heuristic()<<endl;
+				child.print();
+			}
+		}
+		//method that returns the number of nodes in the tree, counting only
+		//the children that have been started
+		int size(){
+			return 1 + count(block.load(memory_order_acquire));
+		}
+		/*method called on the root to keep the tree under a node budget: the
+		  subtrees below the least visited expanded nodes are dropped, fewest
+		  visits first, until the tree holds no more than target of the nodes
+		  it was holding. Those nodes stay in the tree as leaves, and the
+		  values of their children live on in the transposition table, if
+		  there is one, as priors for when they are started again. Returns
+		  the nodes dropped.*/
+		size_t evict(node_arena<P>* arena, size_t nodes, size_t target){
+			child_block<P>* b = block.load(memory_order_acquire);
+			if(b == NULL)	return 0;
+			vector<eviction_candidate> expanded_nodes;
+			collect_expanded(b, expanded_nodes);
+			sort(expanded_nodes.begin(), expanded_nodes.end());
+			size_t dropped = 0;
+			for(size_t i = 0; i < expanded_nodes.size(); i++){
+				if(nodes <= target + dropped)	break;
+				//nodes below one dropped earlier are already leaves
+				dropped += release(*expanded_nodes[i].slot, arena);
+			}
+			return dropped;
+		}
+		/*method that appends this node's tree to records in breadth first
+		  order, as laid out in checkpoint.h. An expanded node's four records
+		  are written whether or not its children were started, a child that
+		  was not being written unvisited with the board it would hold.*/
+		void save(vector<checkpoint_node>& records){
+			//every node written so far with its board and block, in record order
+			vector<pair<P, child_block<P>*>> order;
+			order.push_back(make_pair(state, block.load(memory_order_acquire)));
+			records.push_back(record_of(state, getValue(), getVisits()));
+			size_t first = records.size() - 1;
+			for(size_t i = 0; i < order.size(); i++){
+				P board = order[i].first;
+				child_block<P>* b = order[i].second;
+				if(b == NULL)	continue;
+				records[first + i].children = records.size() - first;
+				for(int c = 0; c < 4; c++){
+					if(!((b->valid >> c) & 1)){
+						order.push_back(make_pair(P(), (child_block<P>*)NULL));
+						records.push_back(record_of(P(), 0, 0));
+						continue;
+					}
+					P child = board.after(c);
+					order.push_back(make_pair(child, b->blocks[c].load(memory_order_acquire)));
+					if((b->started.load(memory_order_acquire) >> c) & 1)
+						records.push_back(record_of(child, b->values[c].load(memory_order_relaxed),
+									    b->visits[c].load(memory_order_relaxed)));
+					else	records.push_back(record_of(child, 0, 0));
+				}
+			}
+		}
+		//a record holding a board, 0 for an invalid move, its children left
+		//for save to fill in
+		static checkpoint_node record_of(const P& board, double total, int visits){
+			checkpoint_node r;
+			typename P::word packed = board.packed();
+			r.board_low = (uint64_t)packed;
+			r.board_high = (uint64_t)(packed >> 32 >> 32);
+			r.total_val = total;
+			r.visits = visits;
+			r.children = 0;
+			return r;
+		}
+		/*method that rebuilds the tree below records[index], the record this
+		  root was built from, out of the count records of its tree, taking a
+		  block from the arena for every node that was expanded. Returns NULL
+		  on success or what was wrong with the records, in which case the
+		  tree is only partly built and should be dropped.*/
+		const char* restore(const checkpoint_node* records, uint64_t count, uint64_t index,
+				    node_arena<P>& arena){
+			if(records[index].visits < 0
+			   || !restore(block, state, records, count, index, arena))
+				return "tree records do not match their boards";
+			return NULL;
+		}
+
+		//this method contains and drives all four steps of the tree search
+		//when the tree is shared between threads, every node on the way down
+		//carries a virtual loss until the walk's value has been backpropagated
+		void mcts(search_context<P>& ctx){
+
+		//step one: finding a leaf node based off ucb1
+			STAT(long long clock = stat_clock();)
+			STAT(int depth = 0;)
+			if(ctx.shared)	virtual_loss.fetch_add(1, memory_order_relaxed);
+			//follow UCB1 down until a leaf node is reached, going from child
+			//block to child block with the visits of the node the block
+			//belongs to, and recording every step for backpropagation
+			ctx.path.clear();
+			const P* board = &state;
+			atomic<child_block<P>*>* leaf = &block;
+			child_block<P>* b = block.load(memory_order_acquire);
+			int parent_visits = getVisits() + virtual_loss.load(memory_order_relaxed);
+			while(b != NULL){
+				//the pick method returns the index of the optimal 
+				//child to follow using ucb1
+				int index = pick(b, parent_visits);
+				path_step<P> step;
+				step.block = b;
+				step.index = index;
+				step.board = board->after(index);
+				ctx.path.push_back(step);
+				board = &ctx.path.back().board;
+				//starting the child if nobody has yet
+				start(b, index, *board, ctx);
+				if(ctx.shared)	b->virtual_loss[index].fetch_add(1, memory_order_relaxed);
+				parent_visits = b->visits[index].load(memory_order_relaxed)
+					      + b->virtual_loss[index].load(memory_order_relaxed);
+				leaf = &b->blocks[index];
+				b = leaf->load(memory_order_acquire);
+				STAT(depth++;)
+			}
+			STAT(ctx.stats.leaves++;)
+			STAT(ctx.stats.depth_total += depth;)
+			STAT(if(depth > ctx.stats.max_depth)	ctx.stats.max_depth = depth;)
+			STAT(long long now = stat_clock();)
+			STAT(ctx.stats.select_ns += now - clock;)
+			STAT(clock = now;)
+			//now the leaf is reached, need to check if already visited
+			int leaf_visits = ctx.path.empty() ? getVisits()
+					  : ctx.path.back().block->visits[ctx.path.back().index].load(memory_order_relaxed);
+			if(leaf_visits != 0){
+				//already visited, expand children
+
+		//step three: expand (only sometimes, when leaf node is visited)
+				if(expand(*leaf, *board, ctx))	ctx.expansions++;
+			}
+			STAT(now = stat_clock();)
+			STAT(ctx.stats.expand_ns += now - clock;)
+			STAT(clock = now;)
+			//now the leaf is ready for random walk
+
+		//step three and first half of step four: random walk and backpropagate back to leaf
+			double r_val;
+			if(ctx.expected){
+				//expected value walks, the batch being run one walk at a time
+				double total = 0;
+				for(int w = 0; w < ctx.batch; w++)
+					total += expected_walk(ctx.rollout_steps, *board, ctx.rng, &ctx.stats, ctx.pdb);
+				r_val = total / ctx.batch / ctx.rollout_steps;
+				ctx.rollouts += ctx.batch;
+			}
+			else if(ctx.batch > 1){
+				//several walks at once, backpropagating their mean
+				rollout_stats stats = batch_walk(ctx, *board);
+				r_val = stats.mean / ctx.rollout_steps;
+				STAT(ctx.stats.batches++;)
+				STAT(ctx.stats.batch_variance += stats.variance / ctx.batch
+						/ ((double)ctx.rollout_steps * ctx.rollout_steps);)
+				ctx.rollouts += ctx.batch;
+				STAT(ctx.stats.rollout_steps += (long long)ctx.batch * (ctx.rollout_steps + 1);)
+			}
+			else{
+				r_val = sampled_walk(ctx, *board) / ctx.rollout_steps;
+				ctx.rollouts++;
+			}
+			STAT(now = stat_clock();)
+			STAT(ctx.stats.rollout_ns += now - clock;)
+			STAT(clock = now;)
+
+		//step four finished: backpropagate values up the tree to the root
+			//every node on the path is credited with the walk's value, so a node's
+			//total value is the sum of the walks through it and totals from separate
+			//trees can be added together
+			for(size_t k = ctx.path.size(); k-- > 0;){
+				const path_step<P>& step = ctx.path[k];
+				//add on total value and increment visits
+				atomic_add(step.block->values[step.index], r_val);
+				step.block->visits[step.index].fetch_add(1, memory_order_relaxed);
+				if(ctx.shared)	step.block->virtual_loss[step.index].fetch_sub(1, memory_order_relaxed);
+				if(ctx.table != NULL)	ctx.table->update(step.board, r_val);
+			}
+			//finally, update the root
+			atomic_add(total_val, r_val);
+			visits.fetch_add(1, memory_order_relaxed);
+			if(ctx.shared)	virtual_loss.fetch_sub(1, memory_order_relaxed);
+			if(ctx.table != NULL)	ctx.table->update(state, r_val);
+			STAT(ctx.stats.backprop_ns += stat_clock() - clock;)
+			return;	
+		}
+
+		//the child to descend into from the root, -1 if it was never expanded
+		int pick_child(){
+			child_block<P>* b = block.load(memory_order_acquire);
+			if(b == NULL)	return -1;
+			return pick(b, getVisits() + virtual_loss.load(memory_order_relaxed));
+		}
+		//visits and total value of the child for a move, 0 if it was never started
+		int child_visits(int index){
+			child_block<P>* b = block.load(memory_order_acquire);
+			return b == NULL ? 0 : b->visits[index].load(memory_order_relaxed);
+		}
+		double child_value(int index){
+			child_block<P>* b = block.load(memory_order_acquire);
+			return b == NULL ? 0 : b->values[index].load(memory_order_relaxed);
+		}
+		//method called on root to decide a move, picking the most visited child
+		//since the exploration bonus in UCB1 is there to steer the search, not
+		//the final decision; for ties, the first tied child is picked
+		int best_child(){
+			if(isLeaf())	return -1;
+			const int* valid = moves();
+			int max_visits = -1;
+			int max_index = -1;
+			for(int k = 0; k < move_count(); k++){
+				int v = child_visits(valid[k]);
+				if(v > max_visits){
+					max_visits = v;
+					max_index = valid[k];
+				}
+			}
+			return max_index;
+		}
+		char pick_move(){
+			int index = best_child();
+			if(index < 0)	return 'Z';
+			return map[index];
+		}
+		//method called on the root before every search, marking where the
+		//visits counted by visit_gap start from
+		void begin_search(){
+			for(int i = 0; i < 4; i++)	searched[i] = child_visits(i);
+		}
+		//how many visits the most visited child is ahead of the runner up by,
+		//counting only the visits since begin_search, INT32_MAX when there is
+		//only one move to make
+		int visit_gap(){
+			if(isLeaf())	return 0;
+			const int* valid = moves();
+			int first = -1;
+			int second = -1;
+			for(int k = 0; k < move_count(); k++){
+				int v = child_visits(valid[k]) - searched[valid[k]];
+				if(v > first){
+					second = first;
+					first = v;
+				}
+				else if(v > second)	second = v;
+			}
+			if(second < 0)	return INT32_MAX;
+			return first - second;
+		}
+};
+
+/*	Search controller:
+	decides when the search for a move stops. It is built once per move and
+	shared by every thread of the search, which each ask it after every
+	iteration. The root is always expanded before any limit is honoured, so
+	there is a move to pick however tight the limits are.
+*/
+class search_controller{
+	private:
+		search_limits limits;
+		size_t node_share;
+		chrono::steady_clock::time_point start;
+		chrono::steady_clock::time_point deadline;
+	public:
+		//threads is the number of trees or arenas the node budget is split over
+		search_controller(const search_limits& l, int threads){
+			limits = l;
+			node_share = limits.nodes / (threads < 1 ? 1 : threads);
+			if(limits.nodes > 0 && node_share == 0)	node_share = 1;
+			start = chrono::steady_clock::now();
+			deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+					chrono::duration<double>(limits.seconds));
+		}
+		//returns why the search should stop, or NULL to keep going, given the
+		//iterations done so far, the nodes held by the asking thread and the root
+		template <class N>
+		const char* stop(int completed, size_t nodes, N& root) const{
+			if(root.isLeaf())	return NULL;
+			if(completed >= limits.iterations)	return "iterations";
+			if(node_share > 0 && nodes >= node_share)	return "nodes";
+			chrono::steady_clock::time_point now = chrono::steady_clock::now();
+			if(limits.seconds > 0 && now >= deadline)	return "deadline";
+			if(!limits.early_stop || completed < EARLY_STOP_ITERATIONS)	return NULL;
+			//iterations that could still be run, estimated from the rate so far
+			//when there is a deadline and a rate to go by
+			double remaining = (double)limits.iterations - completed;
+			if(limits.seconds > 0 && completed > 0){
+				double elapsed = chrono::duration<double>(now - start).count();
+				double left = chrono::duration<double>(deadline - now).count();
+				if(elapsed > 0 && completed / elapsed * left < remaining)
+					remaining = completed / elapsed * left;
+			}
+			if(root.visit_gap() > remaining)	return "early";
+			return NULL;
+		}
+		double elapsed() const{
+			return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		}
+};
+
+//finds the first record holding the board in a checkpoint's tree, which
+//being in breadth first order is the shallowest, returning false if none does
+template <class P>
+inline bool find_record(const checkpoint_node* records, uint64_t count, const P& board,
+			uint64_t& index){
+	typename P::word packed = board.packed();
+	uint64_t low = (uint64_t)packed;
+	uint64_t high = (uint64_t)(packed >> 32 >> 32);
+	for(index = 0; index < count; index++)
+		if(records[index].board_low == low && records[index].board_high == high)	return true;
+	return false;
+}
+
+//a tree's or thread's share of a node budget, at least one node when there is a budget
+inline size_t budget_share(size_t budget, int threads){
+	if(budget == 0)	return 0;
+	size_t share = budget / (threads < 1 ? 1 : threads);
+	return share == 0 ? 1 : share;
+}
+
+/*	Tree search interface:
+	the ways of searching a board with one or more threads. Every search keeps
+	its trees between real moves and reports the same summaries.
+*/
+template <class P>
+class tree_search{
+	public:
+		virtual ~tree_search(){}
+		//searches until one of the limits is reached, the iteration limit
+		//counting iterations per tree, or per thread for a shared tree
+		virtual search_report search(const search_limits& limits) = 0;
+		//index of the root child to move to, -1 if the root was never expanded
+		virtual int pick_child() = 0;
+		char pick_move(){
+			int index = pick_child();
+			if(index < 0)	return 'Z';
+			return map[index];
+		}
+		//average value of a root child, 0 if it was never visited
+		virtual double child_average(int index) = 0;
+		//visits of a root child, 0 if it is not a valid move
+		virtual int child_visits(int index) = 0;
+		//moves the search on to the board a real move landed on,
+		//returning true if search work was kept
+		virtual bool reroot(const P& board) = 0;
+		//drops every tree and starts over from a new board, reseeding the
+		//generators as if the search had just been built with the seed,
+		//but keeping the memory already reserved
+		virtual void reset(const P& board, uint64_t seed) = 0;
+		//writes every tree to a checkpoint at path, returning NULL on success
+		//or what went wrong
+		virtual const char* save(const char* path) = 0;
+		//starts over from the checkpoint's trees, rooted at the shallowest node
+		//holding the board, setting loaded to the nodes loaded, 0 if no tree
+		//holds it. Returns NULL on success or what was wrong with the trees,
+		//in which case the search is left at a fresh root on the board
+		virtual const char* load(const checkpoint_file& file, const P& board, size_t& loaded) = 0;
+		//summaries over every tree
+		virtual int iterations() = 0;
+		virtual int expansions() = 0;
+		virtual long long evicted() = 0;
+		//counters and timers over every search so far, the deepest leaf
+		//being the deepest of the last search alone
+		virtual search_stats stats() = 0;
+		virtual int size() = 0;
+		virtual size_t peak_bytes() = 0;
+		virtual size_t peak_nodes() = 0;
+		virtual uint64_t table_hits() = 0;
+		virtual uint64_t table_probes() = 0;
+		virtual uint64_t table_replacements() = 0;
+};
+
+/*	Root parallel search:
+	runs several independent searches from the same board, its replicas, one
+	per thread unless told otherwise, each with its own generator, arenas,
+	transposition table and tree. Each thread takes every so many replicas
+	and runs an iteration of each in turn. Once every tree has finished, the
+	visits and values of each root's children are summed in replica order and
+	the move is the child with the most visits over every tree, exactly as a
+	single root would pick it. With one thread the search runs on the calling
+	thread, and with one replica it makes the same decisions as a lone root.
+	Replica t draws from the seed mixed with t, iteration i of move m drawing
+	from the stream at (m, i), so a tree grows the same way whichever thread
+	runs it. Limited by iterations or nodes rather than a deadline, a search
+	with a given seed and number of replicas makes the same decisions on any
+	number of threads.
+	With a node budget, each tree gets an even share of it, and a tree that
+	reaches its share evicts its least visited subtrees back down to three
+	quarters of it in between iterations, the freed blocks being reused by the
+	expansions that follow. Between moves the kept subtree is copied into the
+	spare arena, so up to twice the budget may be reserved.
+*/
+template <class P>
+class root_parallel : public tree_search<P>{
+	private:
+		struct worker{
+			search_context<P> ctx;
+			transposition_table<P> table;
+			Node<P> root;
+			//iterations completed during the last search and what stopped it
+			int iterations;
+			const char* stop;
+			worker(uint64_t seed, const search_options& options, const P& board)
+				: ctx(seed, options), table(TABLE_ENTRIES), root(board){
+				ctx.table = &table;
+				iterations = 0;
+				stop = "iterations";
+			}
+		};
+		vector<worker*> workers;
+		int threads;
+
+		//runs workers first, first + stride and so on, one iteration of each
+		//in turn, until the controller has stopped every one of them
+		static void run(vector<worker*>* workers, size_t first, size_t stride,
+				const search_controller* control){
+			vector<worker*> running;
+			for(size_t t = first; t < workers->size(); t += stride){
+				(*workers)[t]->table.new_search();
+				(*workers)[t]->root.begin_search();
+				(*workers)[t]->iterations = 0;
+				running.push_back((*workers)[t]);
+			}
+			while(!running.empty()){
+				for(size_t r = 0; r < running.size();){
+					worker* w = running[r];
+					if((w->stop = control->stop(w->iterations,
+							w->ctx.arena.nodes(), w->root)) != NULL){
+						running[r] = running.back();
+						running.pop_back();
+						continue;
+					}
+					w->ctx.begin_iteration(w->iterations);
+					w->root.mcts(w->ctx);
+					w->iterations++;
+					size_t nodes = w->ctx.arena.nodes();
+					if(w->ctx.node_budget > 0 && nodes >= w->ctx.node_budget)
+						w->ctx.evicted += w->root.evict(&w->ctx.arena, nodes,
+								w->ctx.node_budget * EVICTION_QUARTERS / 4);
+					r++;
+				}
+			}
+		}
+		long long rollouts(){
+			long long result = 0;
+			for(size_t t = 0; t < workers.size(); t++)	result += workers[t]->ctx.rollouts;
+			return result;
+		}
+	public:
+		root_parallel(const search_options& options, uint64_t seed, const P& board){
+			threads = options.threads < 1 ? 1 : options.threads;
+			int replicas = options.replicas < 1 ? threads : options.replicas;
+			//replica 0 keeps the given seed so a single replica matches a lone root
+			for(int t = 0; t < replicas; t++){
+				workers.push_back(new worker(seed ^ (t * 0x9E3779B97F4A7C15ULL),
+							     options, board));
+				workers.back()->ctx.node_budget = budget_share(options.node_budget, replicas);
+			}
+		}
+		~root_parallel(){
+			for(size_t t = 0; t < workers.size(); t++)	delete workers[t];
+		}
+		root_parallel(const root_parallel&) = delete;
+		root_parallel& operator=(const root_parallel&) = delete;
+
+		//searches every tree, in parallel when there is more than one,
+		//reporting the stop reason of the first tree
+		search_report search(const search_limits& limits){
+			search_controller control(limits, workers.size());
+			long long before = rollouts();
+			int expanded_before = expansions();
+			long long evicted_before = evicted();
+			search_stats stats_before = stats();
+			for(size_t t = 0; t < workers.size(); t++)	workers[t]->ctx.stats.max_depth = 0;
+			size_t running = (size_t)threads < workers.size() ? threads : workers.size();
+			if(running == 1)	run(&workers, 0, 1, &control);
+			else{
+				vector<thread> pool;
+				for(size_t t = 0; t < running; t++)
+					pool.push_back(thread(run, &workers, t, running, &control));
+				for(size_t t = 0; t < pool.size(); t++)	pool[t].join();
+			}
+			search_report report;
+			report.iterations = iterations();
+			report.rollouts = rollouts() - before;
+			report.expansions = expansions() - expanded_before;
+			report.seconds = control.elapsed();
+			report.stop = workers[0]->stop;
+			report.evicted = evicted() - evicted_before;
+			report.stats = stats().since(stats_before);
+			return report;
+		}
+		//merges the root children of every tree and returns the index of the
+		//child with the most visits, -1 if no tree has been expanded
+		int pick_child(){
+			int visits[4] = {0, 0, 0, 0};
+			bool valid[4] = {false, false, false, false};
+			for(size_t t = 0; t < workers.size(); t++){
+				Node<P>& root = workers[t]->root;
+				if(root.isLeaf())	continue;
+				for(int i = 0; i < 4; i++){
+					if(!root.hasMove(i))	continue;
+					valid[i] = true;
+					visits[i] += root.child_visits(i);
+				}
+			}
+			int max_visits = -1;
+			int max_index = -1;
+			for(int i = 0; i < 4; i++){
+				if(valid[i] && visits[i] > max_visits){
+					max_visits = visits[i];
+					max_index = i;
+				}
+			}
+			return max_index;
+		}
+		//merged average value of a root child, 0 if it was never visited
+		double child_average(int index){
+			double total = 0;
+			int visits = 0;
+			for(size_t t = 0; t < workers.size(); t++){
+				Node<P>& root = workers[t]->root;
+				if(!root.hasChild(index))	continue;
+				total += root.child_value(index);
+				visits += root.child_visits(index);
+			}
+			if(visits == 0)	return 0;
+			return total / visits;
+		}
+		//merged visits of a root child
+		int child_visits(int index){
+			int visits = 0;
+			for(size_t t = 0; t < workers.size(); t++)	visits += workers[t]->root.child_visits(index);
+			return visits;
+		}
+		//moves every tree on to the board a real move landed on, returning
+		//true if the first tree kept its search work
+		bool reroot(const P& board){
+			bool reused = false;
+			for(size_t t = 0; t < workers.size(); t++){
+				workers[t]->ctx.move++;
+				bool kept = workers[t]->root.reroot(board, workers[t]->ctx);
+				if(t == 0)	reused = kept;
+			}
+			return reused;
+		}
+		//one checkpointed tree per worker, as many as the file holds
+		const char* save(const char* path){
+			size_t count = workers.size() < CHECKPOINT_MAX_TREES ? workers.size() : CHECKPOINT_MAX_TREES;
+			vector<vector<checkpoint_node>> trees(count);
+			for(size_t t = 0; t < count; t++)	workers[t]->root.save(trees[t]);
+			return write_checkpoint(path, P::ROWS, P::COLUMNS, trees);
+		}
+		//worker t loads tree t, wrapping around when there are more workers than trees
+		const char* load(const checkpoint_file& file, const P& board, size_t& loaded){
+			loaded = 0;
+			for(size_t t = 0; t < workers.size(); t++){
+				worker* w = workers[t];
+				uint64_t count;
+				uint64_t index;
+				const checkpoint_node* records = file.tree(t % file.trees(), count);
+				if(!find_record(records, count, board, index))	continue;
+				w->ctx.arena.reset();
+				w->ctx.spare.reset();
+				w->root = Node<P>(records[index]);
+				const char* error = w->root.restore(records, count, index, w->ctx.arena);
+				if(error != NULL){
+					for(size_t u = 0; u <= t; u++){
+						workers[u]->ctx.arena.reset();
+						workers[u]->root = Node<P>(board);
+					}
+					loaded = 0;
+					return error;
+				}
+				loaded += w->root.size();
+			}
+			return NULL;
+		}
+		void reset(const P& board, uint64_t seed){
+			for(size_t t = 0; t < workers.size(); t++){
+				worker* w = workers[t];
+				w->ctx.seed(seed ^ (t * 0x9E3779B97F4A7C15ULL));
+				w->ctx.arena.reset();
+				w->ctx.spare.reset();
+				w->table.clear();
+				w->root = Node<P>(board);
+				w->iterations = 0;
+			}
+		}
+		//summaries over every tree
+		int iterations(){
+			int result = 0;
+			for(size_t t = 0; t < workers.size(); t++)	result += workers[t]->iterations;
+			return result;
+		}
+		int expansions(){
+			int result = 0;
+			for(size_t t = 0; t < workers.size(); t++)	result += workers[t]->ctx.expansions;
+			return result;
+		}
+		long long evicted(){
+			long long result = 0;
+			for(size_t t = 0; t < workers.size(); t++)	result += workers[t]->ctx.evicted;
+			return result;
+		}
+		search_stats stats(){
+			search_stats result;
+			for(size_t t = 0; t < workers.size(); t++)	result.add(workers[t]->ctx.stats);
+			return result;
+		}
+		int size(){
+			int result = 0;
+			for(size_t t = 0; t < workers.size(); t++)	result += workers[t]->root.size();
+			return result;
+		}
+		size_t peak_bytes(){
+			size_t result = 0;
+			for(size_t t = 0; t < workers.size(); t++)
+				result += workers[t]->ctx.arena.peak_bytes() + workers[t]->ctx.spare.peak_bytes();
+			return result;
+		}
+		size_t peak_nodes(){
+			size_t result = 0;
+			for(size_t t = 0; t < workers.size(); t++)
+				result += workers[t]->ctx.arena.peak_nodes() + workers[t]->ctx.spare.peak_nodes();
+			return result;
+		}
+		uint64_t table_hits(){
+			uint64_t result = 0;
+			for(size_t t = 0; t < workers.size(); t++)	result += workers[t]->table.hit_count();
+			return result;
+		}
+		uint64_t table_probes(){
+			uint64_t result = 0;
+			for(size_t t = 0; t < workers.size(); t++)	result += workers[t]->table.probe_count();
+			return result;
+		}
+		uint64_t table_replacements(){
+			uint64_t result = 0;
+			for(size_t t = 0; t < workers.size(); t++)
+				result += workers[t]->table.replacement_count();
+			return result;
+		}
+};
+
+/*	Shared tree search:
+	runs several threads over one tree. Each thread has its own generator,
+	arena and context, every generator keyed by the same seed and moved to
+	the stream of each iteration it is handed, so iteration i of move m
+	draws the same numbers whichever thread runs it, though with more than
+	one thread the tree it descends depends on how the threads interleave.
+	Each thread descends with virtual loss so that threads spread over
+	different branches, and expands a leaf only if it is the one to publish
+	the leaf's child block, so the tree never needs a lock. Blocks expanded by any thread stay
+	valid until the next real move, when the kept subtree is compacted into
+	the first thread's arena and every other arena is reset. The transposition
+	table is not safe to share, so this search runs without one.
+	Nodes cannot be evicted while other threads may be passing through them,
+	so with a node budget the tree is cut back to three quarters of the budget
+	before each search, by dropping the least visited subtrees and compacting
+	what is left into the first thread's arena. The room left under the budget
+	is split between the threads, and a thread that fills its share during the
+	search stops the search.
+*/
+template <class P>
+class shared_tree : public tree_search<P>{
+	private:
+		vector<search_context<P>*> contexts;
+		Node<P> root;
+		//iterations handed out and completed during the last search
+		atomic<int> claimed;
+		atomic<int> completed;
+		//set by the first thread told to stop, which also records why,
+		//so that every other thread stops with it
+		atomic<bool> stopped;
+		const char* stop;
+		size_t budget;
+
+		//runs one thread until the controller stops any thread, counting
+		//iterations as they are handed out so the budget is never overrun
+		static void run(shared_tree* tree, search_context<P>* ctx, const search_controller* control){
+			while(!tree->stopped.load(memory_order_relaxed)){
+				size_t nodes = ctx->arena.nodes();
+				int iteration = tree->claimed.fetch_add(1);
+				const char* reason = control->stop(iteration, nodes, tree->root);
+				if(reason == NULL && ctx->node_budget > 0 && nodes >= ctx->node_budget)
+					reason = "budget";
+				if(reason != NULL){
+					bool expected = false;
+					if(tree->stopped.compare_exchange_strong(expected, true))	tree->stop = reason;
+					break;
+				}
+				ctx->begin_iteration(iteration);
+				tree->root.mcts(*ctx);
+				tree->completed.fetch_add(1, memory_order_relaxed);
+			}
+		}
+		long long rollouts(){
+			long long result = 0;
+			for(size_t t = 0; t < contexts.size(); t++)	result += contexts[t]->rollouts;
+			return result;
+		}
+		//nodes held by every arena, only to be asked while no thread is searching
+		size_t nodes_held(){
+			size_t nodes = 0;
+			for(size_t t = 0; t < contexts.size(); t++)
+				nodes += contexts[t]->arena.nodes();
+			return nodes;
+		}
+		//cuts the tree back under the budget while no thread is searching it,
+		//then splits the room left over between the threads, each thread's
+		//budget being the size its own arena may grow to
+		void make_room(){
+			if(budget == 0)	return;
+			size_t nodes = nodes_held();
+			size_t target = budget * EVICTION_QUARTERS / 4;
+			if(nodes > target){
+				contexts[0]->evicted += root.evict(NULL, nodes, target);
+				contexts[0]->spare.reset();
+				root.copy_children(contexts[0]->spare);
+				contexts[0]->arena.swap(contexts[0]->spare);
+				for(size_t t = 1; t < contexts.size(); t++)	contexts[t]->arena.reset();
+				nodes = nodes_held();
+			}
+			size_t room = budget_share(budget > nodes ? budget - nodes : 1, contexts.size());
+			for(size_t t = 0; t < contexts.size(); t++)
+				contexts[t]->node_budget = contexts[t]->arena.nodes() + room;
+		}
+	public:
+		shared_tree(const search_options& options, uint64_t seed, const P& board)
+			: root(board){
+			int threads = options.threads < 1 ? 1 : options.threads;
+			for(int t = 0; t < threads; t++){
+				contexts.push_back(new search_context<P>(seed, options));
+				contexts.back()->shared = true;
+			}
+			budget = options.node_budget;
+			claimed = 0;
+			completed = 0;
+			stopped = false;
+			stop = "iterations";
+		}
+		~shared_tree(){
+			for(size_t t = 0; t < contexts.size(); t++)	delete contexts[t];
+		}
+		shared_tree(const shared_tree&) = delete;
+		shared_tree& operator=(const shared_tree&) = delete;
+
+		//every thread works on the one tree, sharing a budget of
+		//the given iterations per thread
+		search_report search(const search_limits& limits){
+			search_limits shared = limits;
+			if(shared.iterations < INT32_MAX / (int)contexts.size())
+				shared.iterations *= contexts.size();
+			else	shared.iterations = INT32_MAX - (int)contexts.size();
+			search_controller control(shared, contexts.size());
+			long long before = rollouts();
+			int expanded_before = expansions();
+			long long evicted_before = evicted();
+			make_room();
+			search_stats stats_before = stats();
+			for(size_t t = 0; t < contexts.size(); t++)	contexts[t]->stats.max_depth = 0;
+			claimed = 0;
+			completed = 0;
+			stopped = false;
+			root.begin_search();
+			vector<thread> threads;
+			for(size_t t = 0; t < contexts.size(); t++)
+				threads.push_back(thread(run, this, contexts[t], &control));
+			for(size_t t = 0; t < threads.size(); t++)	threads[t].join();
+			search_report report;
+			report.iterations = completed.load();
+			report.rollouts = rollouts() - before;
+			report.expansions = expansions() - expanded_before;
+			report.seconds = control.elapsed();
+			report.stop = stop;
+			report.evicted = evicted() - evicted_before;
+			report.stats = stats().since(stats_before);
+			return report;
+		}
+		int pick_child(){
+			return root.best_child();
+		}
+		double child_average(int index){
+			if(!root.hasChild(index) || root.child_visits(index) == 0)	return 0;
+			return root.child_value(index) / root.child_visits(index);
+		}
+		int child_visits(int index){
+			return root.child_visits(index);
+		}
+		bool reroot(const P& board){
+			for(size_t t = 0; t < contexts.size(); t++)	contexts[t]->move++;
+			if(root.getState().equals(board))	return true;
+			bool kept = root.reroot(board, *contexts[0]);
+			for(size_t t = 1; t < contexts.size(); t++)	contexts[t]->arena.reset();
+			return kept;
+		}
+		const char* save(const char* path){
+			vector<vector<checkpoint_node>> trees(1);
+			root.save(trees[0]);
+			return write_checkpoint(path, P::ROWS, P::COLUMNS, trees);
+		}
+		//the one tree is taken from the checkpoint's first tree
+		const char* load(const checkpoint_file& file, const P& board, size_t& loaded){
+			uint64_t count;
+			uint64_t index;
+			loaded = 0;
+			const checkpoint_node* records = file.tree(0, count);
+			if(!find_record(records, count, board, index))	return NULL;
+			for(size_t t = 0; t < contexts.size(); t++){
+				contexts[t]->arena.reset();
+				contexts[t]->spare.reset();
+			}
+			root = Node<P>(records[index]);
+			const char* error = root.restore(records, count, index, contexts[0]->arena);
+			if(error != NULL){
+				contexts[0]->arena.reset();
+				root = Node<P>(board);
+				return error;
+			}
+			loaded = root.size();
+			return NULL;
+		}
+		void reset(const P& board, uint64_t seed){
+			for(size_t t = 0; t < contexts.size(); t++){
+				contexts[t]->seed(seed);
+				contexts[t]->arena.reset();
+				contexts[t]->spare.reset();
+			}
+			root = Node<P>(board);
+			completed = 0;
+		}
+		int iterations(){
+			return completed.load();
+		}
+		int expansions(){
+			int result = 0;
+			for(size_t t = 0; t < contexts.size(); t++)	result += contexts[t]->expansions;
+			return result;
+		}
+		long long evicted(){
+			return contexts[0]->evicted;
+		}
+		search_stats stats(){
+			search_stats result;
+			for(size_t t = 0; t < contexts.size(); t++)	result.add(contexts[t]->stats);
+			return result;
+		}
+		int size(){
+			return root.size();
+		}
+		size_t peak_bytes(){
+			size_t result = 0;
+			for(size_t t = 0; t < contexts.size(); t++)
+				result += contexts[t]->arena.peak_bytes() + contexts[t]->spare.peak_bytes();
+			return result;
+		}
+		size_t peak_nodes(){
+			size_t result = 0;
+			for(size_t t = 0; t < contexts.size(); t++)
+				result += contexts[t]->arena.peak_nodes() + contexts[t]->spare.peak_nodes();
+			return result;
+		}
+		uint64_t table_hits(){
+			return 0;
+		}
+		uint64_t table_probes(){
+			return 0;
+		}
+		uint64_t table_replacements(){
+			return 0;
+		}
+};
+
+//builds the search for the options' mode, "root" for independent trees
+//per thread or "tree" for one tree shared by every thread
+template <class P>
+inline tree_search<P>* make_search(const search_options& options, uint64_t seed, const P& board){
+	if(strcmp(options.mode, "tree") == 0)	return new shared_tree<P>(options, seed, board);
+	return new root_parallel<P>(options, seed, board);
+}
+
+/*	Solve function:
+	plays a whole game from the start board, searching before every move with
+	the given limits, until the goal is reached or max_moves moves have been
+	made. Moves are played out with an environment generator of their own,
+	seeded from the same seed as the search, so a seed always plays the same
+	game. The search handed in is
+	reset to the start board first, so one search can solve board after board.
+	With a position cache, a board the cache is confident about is moved on
+	from without a search, and every search's decision is stored in it.
+*/
+struct solve_result{
+	bool solved;
+	int moves;
+	long long iterations;
+	long long rollouts;
+	long long expansions;
+	long long evicted;
+	//moves played from the position cache without a search
+	long long cached;
+	double seconds;
+	search_stats stats;
+	solve_result(){
+		solved = false;
+		moves = 0;
+		iterations = 0;
+		rollouts = 0;
+		expansions = 0;
+		evicted = 0;
+		cached = 0;
+		seconds = 0;
+	}
+	//adds one move's search to the totals
+	void add(const search_report& report){
+		iterations += report.iterations;
+		rollouts += report.rollouts;
+		expansions += report.expansions;
+		evicted += report.evicted;
+		stats.add(report.stats);
+		moves++;
+	}
+};
+
+//stores the move a search chose for the board it searched from, along with
+//the chosen child's visits and its share of the root's visits
+template <class P>
+inline void cache_decision(position_cache& cache, tree_search<P>& search, const P& board){
+	int index = search.pick_child();
+	if(index < 0)	return;
+	int total = 0;
+	for(int i = 0; i < 4; i++)	total += search.child_visits(i);
+	if(total == 0)	return;
+	int visits = search.child_visits(index);
+	cache.store(board, index, visits, (double)visits / total);
+}
+
+template <class P>
+inline solve_result solve(tree_search<P>& search, const P& start,
+			  const search_limits& limits, uint64_t seed, int max_moves,
+			  position_cache* cache = NULL){
+	solve_result result;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	xoshiro256 environment(seed ^ 0xD1B54A32D192ED03ULL);
+	P board(start);
+	search.reset(board, seed);
+	while(!board.goal_test() && result.moves < max_moves){
+		int cached = cache == NULL ? -1 : cache->lookup(board);
+		if(cached >= 0){
+			result.moves++;
+			result.cached++;
+			board.swap(map[cached], environment);
+			search.reroot(board);
+			continue;
+		}
+		result.add(search.search(limits));
+		if(cache != NULL)	cache_decision(*cache, search, board);
+		board.swap(search.pick_move(), environment);
+		search.reroot(board);
+	}
+	result.solved = board.goal_test();
+	result.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	return result;
+}
+//same as above with a search built just for this board
+template <class P>
+inline solve_result solve(const P& start, const search_options& options,
+			  uint64_t seed, int max_moves){
+	tree_search<P>* search = make_search(options, seed, start);
+	solve_result result = solve(*search, start, options.limits, seed, max_moves, options.cache);
+	delete search;
+	return result;
+}
+
+/*	Summaries:
+	one line of JSON per move and per solve, so runs can be read by scripts.
+	The hot path counters and timers are left out when compiled out.
+*/
+inline void print_move_summary(ostream& out, int index, char move, const search_report& report){
+	out<<"{\"type\":\"move\",\"index\":"<<index<<",\"move\":\""<<move<<"\""
+	   <<",\"iterations\":"<<report.iterations<<",\"rollouts\":"<<report.rollouts
+	   <<",\"expansions\":"<<report.expansions<<",\"evicted\":"<<report.evicted
+	   <<",\"ms\":"<<report.seconds * 1000
+	   <<",\"stop\":\""<<report.stop<<"\"";
+	report.stats.print_fields(out);
+	out<<"}"<<endl;
+}
+inline void print_solve_summary(ostream& out, const solve_result& result){
+	out<<"{\"type\":\"solve\",\"solved\":"<<(result.solved ? "true" : "false")
+	   <<",\"moves\":"<<result.moves<<",\"iterations\":"<<result.iterations
+	   <<",\"rollouts\":"<<result.rollouts<<",\"expansions\":"<<result.expansions
+	   <<",\"evicted\":"<<result.evicted<<",\"cached\":"<<result.cached
+	   <<",\"ms\":"<<result.seconds * 1000;
+	result.stats.print_fields(out);
+	out<<"}"<<endl;
+}
+
+#endif
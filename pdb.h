@@ -0,0 +1,226 @@
+#ifndef PDB_H
+#define PDB_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "puzzlefile.h"
+
+/*	Pattern databases:
+	additive disjoint pattern databases for the fifteen puzzle. The tiles are
+	split into disjoint patterns, and for every placement of a pattern's tiles
+	on the board the database holds the fewest moves of those tiles alone that
+	bring them home, moves of the other tiles being free. Since no move is
+	counted by two patterns, the sum over the patterns never overestimates the
+	moves left, and it is never below the manhatten sum.
+
+	The databases are built once by pdbgen and written to a file that the
+	solver maps into memory instead of rebuilding them. The file is a fixed
+	size header followed by one table per pattern, each starting on a 64 byte
+	boundary and holding one byte per placement. Placements are numbered by
+	their k-permutation rank: the cell of the pattern's first tile, then the
+	cell of the second among the cells left over, and so on, as the digits of
+	a number whose radixes count down from 16.
+*/
+
+//patterns in a file and tiles in a pattern, the largest pattern's table
+//being 16!/9! bytes, and 16 times that while it is built
+#define PDB_MAX_PATTERNS 8
+#define PDB_MAX_TILES 7
+#define PDB_VERSION 1
+#define PDB_MAGIC "PDB15\0\0"
+
+struct pdb_pattern{
+	uint32_t size;
+	unsigned char tiles[PDB_MAX_TILES + 1];
+	//where the pattern's table starts in the file, and its length
+	uint64_t offset;
+	uint64_t entries;
+};
+
+struct pdb_header{
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	pdb_pattern patterns[PDB_MAX_PATTERNS];
+};
+
+//number of placements of a pattern of size tiles
+inline uint64_t pattern_entries(int size){
+	uint64_t result = 1;
+	for(int i = 0; i < size; i++)	result *= 16 - i;
+	return result;
+}
+//k-permutation rank of the cells of a pattern's tiles, in the pattern's order
+inline uint64_t rank_pattern(const int* cells, int size){
+	uint64_t rank = 0;
+	unsigned used = 0;
+	for(int i = 0; i < size; i++){
+		//a cell's digit is its index among the cells not yet taken
+		int digit = cells[i] - __builtin_popcount(used & ((1u << cells[i]) - 1));
+		rank = rank * (16 - i) + digit;
+		used |= 1u << cells[i];
+	}
+	return rank;
+}
+//inverse of rank_pattern
+inline void unrank_pattern(uint64_t rank, int size, int* cells){
+	int digits[PDB_MAX_TILES];
+	for(int i = size - 1; i >= 0; i--){
+		digits[i] = rank % (16 - i);
+		rank /= 16 - i;
+	}
+	unsigned used = 0;
+	for(int i = 0; i < size; i++){
+		int cell = 0;
+		for(int skip = digits[i]; ; cell++){
+			if(used & (1u << cell))	continue;
+			if(skip-- == 0)	break;
+		}
+		cells[i] = cell;
+		used |= 1u << cell;
+	}
+}
+
+/*pattern_database class:
+	a pattern database file mapped read only into memory. Every search thread
+	reads the same pages, and the operating system shares them with any other
+	process that maps the same file.
+*/
+class pattern_database{
+	private:
+		void* mapping;
+		size_t bytes;
+		const pdb_header* header;
+		const unsigned char* tables[PDB_MAX_PATTERNS];
+	public:
+		pattern_database(){
+			mapping = NULL;
+			bytes = 0;
+			header = NULL;
+		}
+		~pattern_database(){
+			if(mapping != NULL)	munmap(mapping, bytes);
+		}
+		//databases own their mapping, so they cannot be copied
+		pattern_database(const pattern_database&) = delete;
+		pattern_database& operator=(const pattern_database&) = delete;
+
+		//maps the file at path, returning NULL on success or what was wrong
+		//with the file, in which case the database is left empty
+		const char* load(const char* path){
+			int fd = open(path, O_RDONLY);
+			if(fd < 0)	return "could not open file";
+			struct stat info;
+			if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(pdb_header)){
+				close(fd);
+				return "file too short";
+			}
+			void* m = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if(m == MAP_FAILED)	return "could not map file";
+			const pdb_header* h = (const pdb_header*)m;
+			const char* error = NULL;
+			unsigned covered = 0;
+			if(memcmp(h->magic, PDB_MAGIC, 8) != 0)	error = "not a pattern database";
+			else if(h->version != PDB_VERSION)	error = "wrong version";
+			else if(h->count < 1 || h->count > PDB_MAX_PATTERNS)	error = "bad pattern count";
+			for(uint32_t p = 0; error == NULL && p < h->count; p++){
+				const pdb_pattern& pattern = h->patterns[p];
+				if(pattern.size < 1 || pattern.size > PDB_MAX_TILES){
+					error = "bad pattern size";
+					break;
+				}
+				for(uint32_t t = 0; t < pattern.size; t++){
+					int tile = pattern.tiles[t];
+					if(tile < 1 || tile > 15 || (covered & (1u << tile))){
+						error = "patterns overlap or hold bad tiles";
+						break;
+					}
+					covered |= 1u << tile;
+				}
+				if(pattern.entries != pattern_entries(pattern.size)
+				   || pattern.offset % 64 != 0
+				   || pattern.offset > (uint64_t)info.st_size
+				   || pattern.entries > (uint64_t)info.st_size - pattern.offset)
+					error = "table out of bounds";
+			}
+			if(error != NULL){
+				munmap(m, info.st_size);
+				return error;
+			}
+			if(mapping != NULL)	munmap(mapping, bytes);
+			mapping = m;
+			bytes = info.st_size;
+			header = h;
+			for(uint32_t p = 0; p < h->count; p++)
+				tables[p] = (const unsigned char*)m + h->patterns[p].offset;
+			return NULL;
+		}
+		bool loaded() const{
+			return header != NULL;
+		}
+		int patterns() const{
+			return header == NULL ? 0 : header->count;
+		}
+		const pdb_pattern& pattern(int p) const{
+			return header->patterns[p];
+		}
+		size_t size_bytes() const{
+			return bytes;
+		}
+		//the summed database value of a packed fifteen puzzle board, the
+		//fewest moves the board could be solved in by that reckoning
+		int value(uint64_t board) const{
+			int cell[16];
+			for(int i = 0; i < 16; i++)	cell[(board >> (i << 2)) & 0xF] = i;
+			int sum = 0;
+			for(uint32_t p = 0; p < header->count; p++){
+				const pdb_pattern& pattern = header->patterns[p];
+				int cells[PDB_MAX_TILES];
+				for(uint32_t t = 0; t < pattern.size; t++)	cells[t] = cell[pattern.tiles[t]];
+				sum += tables[p][rank_pattern(cells, pattern.size)];
+			}
+			return sum;
+		}
+		//the same scoring as fifteen_puzzle::heuristic(), with the database
+		//value in place of the manhatten sum
+		double heuristic(const fifteen_puzzle& p) const{
+			if(p.goal_test())	return 1000;
+			return (double)(fifteen_puzzle::MAX_SUM - value(p.packed())) / fifteen_puzzle::SCALE;
+		}
+		//the heuristic the board would have after the valid move map[m] succeeded
+		double heuristic_after(const fifteen_puzzle& p, int m) const{
+			static const int offset[4] = {-4, 4, -1, 1};
+			int zero = p.blank();
+			int next = zero + offset[m];
+			uint64_t board = p.packed();
+			uint64_t moved = (board >> (next << 2)) & 0xF;
+			board ^= (moved << (next << 2)) | (moved << (zero << 2));
+			if(board == goal_board)	return 1000;
+			return (double)(fifteen_puzzle::MAX_SUM - value(board)) / fifteen_puzzle::SCALE;
+		}
+};
+
+//the heuristic of a board, read from the pattern database when there is one
+//and the board is a fifteen puzzle, which is all the databases cover
+template <class P>
+inline double evaluate(const P& state, const pattern_database* pdb){
+	if constexpr(is_same<P, fifteen_puzzle>::value){
+		if(pdb != NULL)	return pdb->heuristic(state);
+	}
+	return state.heuristic();
+}
+template <class P>
+inline double evaluate_after(const P& state, int m, const pattern_database* pdb){
+	if constexpr(is_same<P, fifteen_puzzle>::value){
+		if(pdb != NULL)	return pdb->heuristic_after(state, m);
+	}
+	return state.heuristic_after(m);
+}
+
+#endif
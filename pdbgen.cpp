@@ -0,0 +1,195 @@
+/* 	pdbgen.cpp
+	This program builds the additive pattern databases read by the solver's
+	--pdb option and writes them to a file, see pdb.h for the format.
+
+	usage: pdbgen [FILE] [TILES ...]
+	FILE defaults to fifteen.pdb, and each TILES is a comma separated pattern
+	such as 1,2,5,6,9,13. Without patterns the tiles are split 6-6-3.
+
+	A pattern's table is built by a breadth first search backwards from the
+	goal over placements of the pattern's tiles along with the empty tile.
+	Moving one of the pattern's tiles costs a move and moving any other tile
+	is free, so the search goes level by level over the moves made, and the
+	free moves of a level are taken all at once: every cell the empty tile can
+	reach without moving a pattern tile is one region, and a state is stored
+	once per region, under the region's lowest cell. A placement's value is the
+	lowest over its regions.
+*/
+
+#include "pdb.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+//depth of a search state that has not been reached
+#define UNSEEN 0xFF
+
+//cells outside the left column, and outside the right column
+#define NOT_LEFT 0xEEEE
+#define NOT_RIGHT 0x7777
+
+//every cell the empty tile at cell can reach through the free cells
+static unsigned region(unsigned free, int cell){
+	unsigned reached = 1u << cell;
+	while(true){
+		unsigned grown = reached | ((reached << 4) & 0xFFFF) | (reached >> 4)
+			       | ((reached & NOT_RIGHT) << 1) | ((reached & NOT_LEFT) >> 1);
+		grown &= free | reached;
+		if(grown == reached)	return reached;
+		reached = grown;
+	}
+}
+
+//builds the table for one pattern, one byte per placement
+static vector<unsigned char> build_pattern(const vector<int>& tiles){
+	int size = tiles.size();
+	uint64_t entries = pattern_entries(size);
+	//fewest pattern moves for each placement and region, by the region's lowest cell
+	vector<unsigned char> depth(entries * 16, UNSEEN);
+	int cells[PDB_MAX_TILES];
+	unsigned taken = 0;
+	for(int t = 0; t < size; t++){
+		cells[t] = tiles[t] - 1;
+		taken |= 1u << cells[t];
+	}
+	depth[rank_pattern(cells, size) * 16 + __builtin_ctz(region(~taken & 0xFFFF, 15))] = 0;
+	uint64_t found = 1;
+	for(int level = 0; found > 0; level++){
+		found = 0;
+		for(uint64_t state = 0; state < entries * 16; state++){
+			if(depth[state] != level)	continue;
+			unrank_pattern(state / 16, size, cells);
+			taken = 0;
+			for(int t = 0; t < size; t++)	taken |= 1u << cells[t];
+			unsigned free = ~taken & 0xFFFF;
+			unsigned reach = region(free, state % 16);
+			//every pattern tile next to the region can slide into it
+			for(int t = 0; t < size; t++){
+				int from = cells[t];
+				unsigned bit = 1u << from;
+				unsigned neighbours = ((bit << 4) & 0xFFFF) | (bit >> 4)
+						    | ((bit & NOT_RIGHT) << 1) | ((bit & NOT_LEFT) >> 1);
+				unsigned targets = neighbours & reach;
+				while(targets != 0){
+					int to = __builtin_ctz(targets);
+					targets &= targets - 1;
+					cells[t] = to;
+					unsigned moved_free = (free | bit) & ~(1u << to);
+					uint64_t next = rank_pattern(cells, size) * 16
+						      + __builtin_ctz(region(moved_free, from));
+					if(depth[next] == UNSEEN){
+						depth[next] = level + 1;
+						found++;
+					}
+				}
+				cells[t] = from;
+			}
+		}
+	}
+	vector<unsigned char> table(entries, UNSEEN);
+	for(uint64_t state = 0; state < entries * 16; state++)
+		if(depth[state] < table[state / 16])	table[state / 16] = depth[state];
+	return table;
+}
+
+//reads a comma separated pattern, returning an empty pattern if unreadable
+static vector<int> read_pattern(const string& text){
+	vector<int> tiles;
+	stringstream in(text);
+	string item;
+	while(getline(in, item, ',')){
+		int tile = atoi(item.c_str());
+		if(tile < 1 || tile > 15)	return vector<int>();
+		tiles.push_back(tile);
+	}
+	return tiles;
+}
+
+int main(int argc, char** argv){
+	const char* path = "fifteen.pdb";
+	vector<vector<int>> patterns;
+	if(argc > 1)	path = argv[1];
+	for(int i = 2; i < argc; i++){
+		vector<int> tiles = read_pattern(argv[i]);
+		if(tiles.empty() || (int)tiles.size() > PDB_MAX_TILES){
+			cout<<"PATTERN "<<argv[i]<<" MUST BE 1 TO "<<PDB_MAX_TILES
+			    <<" TILES FROM 1 TO 15. EXITING."<<endl;
+			return 1;
+		}
+		patterns.push_back(tiles);
+	}
+	if(patterns.empty()){
+		patterns.push_back({1, 2, 5, 6, 9, 13});
+		patterns.push_back({3, 4, 7, 8, 11, 12});
+		patterns.push_back({10, 14, 15});
+	}
+	if(patterns.size() > PDB_MAX_PATTERNS){
+		cout<<"AT MOST "<<PDB_MAX_PATTERNS<<" PATTERNS. EXITING."<<endl;
+		return 1;
+	}
+	unsigned covered = 0;
+	for(size_t p = 0; p < patterns.size(); p++){
+		for(size_t t = 0; t < patterns[p].size(); t++){
+			if(covered & (1u << patterns[p][t])){
+				cout<<"TILE "<<patterns[p][t]<<" IS IN MORE THAN ONE PATTERN. EXITING."<<endl;
+				return 1;
+			}
+			covered |= 1u << patterns[p][t];
+		}
+	}
+
+	pdb_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PDB_MAGIC, 8);
+	header.version = PDB_VERSION;
+	header.count = patterns.size();
+	uint64_t offset = (sizeof(header) + 63) & ~63ULL;
+	vector<vector<unsigned char>> tables;
+	for(size_t p = 0; p < patterns.size(); p++){
+		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+		tables.push_back(build_pattern(patterns[p]));
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+		pdb_pattern& pattern = header.patterns[p];
+		pattern.size = patterns[p].size();
+		for(size_t t = 0; t < patterns[p].size(); t++)	pattern.tiles[t] = patterns[p][t];
+		pattern.entries = tables[p].size();
+		pattern.offset = offset;
+		offset = (offset + pattern.entries + 63) & ~63ULL;
+		int deepest = 0;
+		double total = 0;
+		for(size_t i = 0; i < tables[p].size(); i++){
+			if(tables[p][i] > deepest)	deepest = tables[p][i];
+			total += tables[p][i];
+		}
+		cout<<"PATTERN";
+		for(size_t t = 0; t < patterns[p].size(); t++)	cout<<" "<<patterns[p][t];
+		cout<<": "<<pattern.entries<<" PLACEMENTS, MEAN "<<total / pattern.entries
+		    <<", DEEPEST "<<deepest<<", BUILT IN "<<seconds<<" SECONDS"<<endl;
+	}
+
+	ofstream out(path, ios::binary);
+	if(!out){
+		cout<<"COULD NOT OPEN "<<path<<". EXITING."<<endl;
+		return 1;
+	}
+	out.write((const char*)&header, sizeof(header));
+	uint64_t written = sizeof(header);
+	for(size_t p = 0; p < tables.size(); p++){
+		//padding up to the table's 64 byte boundary
+		vector<char> padding(header.patterns[p].offset - written, 0);
+		out.write(padding.data(), padding.size());
+		out.write((const char*)tables[p].data(), tables[p].size());
+		written = header.patterns[p].offset + tables[p].size();
+	}
+	if(!out){
+		cout<<"COULD NOT WRITE "<<path<<". EXITING."<<endl;
+		return 1;
+	}
+	cout<<"WROTE "<<written<<" BYTES TO "<<path<<endl;
+	return 0;
+}
@@ -0,0 +1,128 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include "puzzlefile.h"
+#include "rng.h"
+#include "stats.h"
+#include "pdb.h"
+
+/*	Rollout policies:
+	how a walk picks its next move. Every policy has the same pick method,
+	given the board, the last move that succeeded (-1 before the first) and
+	the search's generator, and the walk is a template over the policy so
+	each compiles to its own loop with the choice inlined.
+
+		retry		draws one of the four moves and draws again until the move
+				is valid, the original walk, kept as the default so seeded
+				runs play the same games
+		uniform		draws once from the board's legal moves, the same choices
+				as retry without the wasted draws
+		no-backtrack	as uniform, but never the move that undoes the last
+				successful one, which only wastes two steps
+		greedy		with chance epsilon as uniform, otherwise the legal move
+				whose board has the best heuristic, ties drawn at random,
+				leaving out the way back so the walk cannot sit on a
+				local best by stepping off it and back again
+
+	Moves are indexes into map, and the move undoing move m is m ^ 1.
+*/
+
+#define POLICY_RETRY 0
+#define POLICY_UNIFORM 1
+#define POLICY_NO_BACKTRACK 2
+#define POLICY_GREEDY 3
+#define GREEDY_EPSILON 0.2
+
+//the policy's name on the command line, or NULL for an unknown policy
+inline const char* policy_name(int policy){
+	switch(policy){
+		case POLICY_RETRY:		return "retry";
+		case POLICY_UNIFORM:		return "uniform";
+		case POLICY_NO_BACKTRACK:	return "no-backtrack";
+		case POLICY_GREEDY:		return "greedy";
+		default:			return NULL;
+	}
+}
+//the policy with the given name, -1 if there is none
+inline int policy_index(const char* name){
+	for(int policy = POLICY_RETRY; policy <= POLICY_GREEDY; policy++)
+		if(strcmp(policy_name(policy), name) == 0)	return policy;
+	return -1;
+}
+
+struct retry_policy{
+	//invalid moves drawn and thrown away
+	long long retries;
+	retry_policy(){
+		retries = 0;
+	}
+	template <class P>
+	int pick(const P& state, int /*previous*/, xoshiro256& rng){
+		int move = rng.below(4);
+		while(!state.valid_swap(map[move])){
+			move = rng.below(4);
+			STAT(retries++;)
+		}
+		return move;
+	}
+};
+
+struct uniform_policy{
+	template <class P>
+	int pick(const P& state, int /*previous*/, xoshiro256& rng){
+		int z = state.blank();
+		return P::lookup.legal[z][rng.below(P::lookup.legal_count[z])];
+	}
+};
+
+struct no_backtrack_policy{
+	template <class P>
+	int pick(const P& state, int previous, xoshiro256& rng){
+		int z = state.blank();
+		const int* legal = P::lookup.legal[z];
+		int count = P::lookup.legal_count[z];
+		if(previous < 0)	return legal[rng.below(count)];
+		//every index has at least two legal moves, one of them the way back,
+		//so there is always one left once it is skipped
+		int pick = rng.below(count - 1);
+		for(int i = 0; i < count; i++){
+			if(legal[i] == (previous ^ 1))	continue;
+			if(pick-- == 0)	return legal[i];
+		}
+		return legal[0];
+	}
+};
+
+struct greedy_policy{
+	double epsilon;
+	//scores the candidate boards in place of the puzzle's heuristic when set
+	const pattern_database* pdb;
+	greedy_policy(double e = GREEDY_EPSILON, const pattern_database* database = NULL){
+		epsilon = e;
+		pdb = database;
+	}
+	template <class P>
+	int pick(const P& state, int previous, xoshiro256& rng){
+		int z = state.blank();
+		const int* legal = P::lookup.legal[z];
+		int count = P::lookup.legal_count[z];
+		if(rng.unit() < epsilon)	return legal[rng.below(count)];
+		int best = legal[0];
+		double best_value = -1;
+		int ties = 0;
+		for(int i = 0; i < count; i++){
+			if(legal[i] == (previous ^ 1))	continue;
+			double value = evaluate_after(state, legal[i], pdb);
+			if(value > best_value){
+				best_value = value;
+				best = legal[i];
+				ties = 1;
+			}
+			//each of the tied moves is kept with an equal chance
+			else if(value == best_value && rng.below(++ties) == 0)	best = legal[i];
+		}
+		return best;
+	}
+};
+
+#endif
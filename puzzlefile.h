@@ -1,6 +1,13 @@
+#ifndef PUZZLEFILE_H
+#define PUZZLEFILE_H
+
 #include <iostream>
 #include <ctime>
 #include <cstring>
+#include <cstdint>
+#include <immintrin.h>
+#include <type_traits>
+#include "rng.h"
 
 using namespace std;
 
@@ -12,87 +19,259 @@ const char map[4] = {'U', 'D', 'L', 'R'};
 //heuristic cutoff
 #define cutoff 73
 
-/*Fifteen_puzzle class:
-	the fifteen_puzzle class is just a representation of a puzzle using an array
+//packed goal board, tiles 1 through 15 in order with the empty tile last
+const uint64_t goal_board = 0x0FEDCBA987654321ULL;
+
+//index of a move letter in map, -1 for letters that are not moves
+constexpr int move_index(char a){
+	return (a == 'U' || a == 'u') ? 0
+	     : (a == 'D' || a == 'd') ? 1
+	     : (a == 'L' || a == 'l') ? 2
+	     : (a == 'R' || a == 'r') ? 3 : -1;
+}
+//odds used by swap_success, a roll of 1 to 100 below them fails the move
+constexpr int move_odds(int zero_tile, char move){
+	//the calculation below for odds returns an integer ranging
+	//from 1 to 85, by messing around with it, im happy with the average
+	//odds of a successful move being 36. these integers can be thought of
+	//as percentages
+	return ((15 + ((int)move % (zero_tile + 5))
+	       *((int)move % (zero_tile + 4))) % 100);
+}
+
+/*sliding puzzle lookups:
+	everything about a board's shape that a move needs, worked out at compile
+	time for every size the puzzle is instantiated with.
+	distance[v][i] is the manhatten distance of tile v sitting at index i from
+	its proper placement at index v-1, so the heuristic can be kept up to date
+	one tile at a time instead of recomputing every tile with divisions and mods.
+	key[v][i] is a fixed random 64 bit zobrist key for tile v sitting at index i.
+	A board's hash is the xor of the keys of all of its placements, so a move
+	changes it by xoring out and in the keys of the two fields that changed.
+	The keys are generated by splitmix64 from a fixed seed.
+	odds[z][m] are the odds of move map[m] with the empty tile at index z, which
+	only depend on the two, and chance[z][m] the share of rolls from 1 to 100
+	that meet them. legal[z] lists the legal_count[z] moves that are valid with
+	the empty tile at index z, in the order of map.
+	Boards are packed into one word, four bits per tile while that fits in 64
+	bits, otherwise five bits per tile in 128 bits, and goal is the packed
+	board with the tiles in order followed by the empty tile.
+*/
+template <int R, int C>
+struct sliding_tables{
+	static const int CELLS = R * C;
+	static const int BITS = CELLS <= 16 ? 4 : 5;
+	static_assert(CELLS * BITS <= 128, "board does not fit in 128 bits");
+	typedef typename conditional<CELLS * BITS <= 64, uint64_t, unsigned __int128>::type word;
+
+	unsigned char distance[CELLS][CELLS];
+	uint64_t key[CELLS][CELLS];
+	int odds[CELLS][4];
+	double chance[CELLS][4];
+	int legal[CELLS][4];
+	int legal_count[CELLS];
+	word goal;
+	constexpr sliding_tables() : distance(), key(), odds(), chance(), legal(), legal_count(), goal(0){
+		for(int v = 1; v < CELLS; v++){
+			for(int i = 0; i < CELLS; i++){
+				int column_difference = (i % C > (v - 1) % C)
+						      ? i % C - (v - 1) % C
+						      : (v - 1) % C - i % C;
+				int row_difference = (i / C > (v - 1) / C)
+						   ? i / C - (v - 1) / C
+						   : (v - 1) / C - i / C;
+				distance[v][i] = row_difference + column_difference;
+			}
+		}
+		uint64_t x = 0x2545F4914F6CDD1DULL;
+		for(int v = 0; v < CELLS; v++){
+			for(int i = 0; i < CELLS; i++){
+				uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+				key[v][i] = z ^ (z >> 31);
+			}
+		}
+		const char moves[4] = {'U', 'D', 'L', 'R'};
+		for(int z = 0; z < CELLS; z++){
+			for(int m = 0; m < 4; m++){
+				odds[z][m] = move_odds(z, moves[m]);
+				int successes = 101 - odds[z][m];
+				if(successes > 100)	successes = 100;
+				chance[z][m] = successes / 100.0;
+			}
+			bool valid[4] = {z >= C, z < CELLS - C, z % C != 0, z % C != C - 1};
+			for(int m = 0; m < 4; m++)
+				if(valid[m])	legal[z][legal_count[z]++] = m;
+		}
+		for(int i = 0; i < CELLS - 1; i++)	goal |= (word)(i + 1) << (i * BITS);
+	}
+};
+
+//scores many packed boards at once, defined below the sliding_puzzle class
+inline void batch_heuristic(const uint64_t* boards, int n, double* out);
+
+/*Sliding_puzzle class:
+	the sliding_puzzle class is a representation of an R by C puzzle packed into
+	a single word, tile i held in bits BITS*i through BITS*i+BITS-1. The fifteen
+	puzzle is sliding_puzzle<4, 4>, four bits per tile in 64 bits.
+	The index of the empty tile is cached alongside the board so that moves never
+	have to scan for it, and moving a tile is a couple of shifts and masks.
+	Every shape dependent number is a compile time constant of the instantiation,
+	so each size compiles to code as specialized as if written for it by hand.
 	The class has various methods that need to be used by the Monte-Carlo Tree Search
 */
-class fifteen_puzzle{
+template <int R, int C>
+class sliding_puzzle{
+	public:
+		static const int ROWS = R;
+		static const int COLUMNS = C;
+		static const int CELLS = R * C;
+		static const int BITS = sliding_tables<R, C>::BITS;
+		typedef typename sliding_tables<R, C>::word word;
+		static constexpr sliding_tables<R, C> lookup = sliding_tables<R, C>();
+		/*the heuristic's constants, 90 and 160 for the fifteen puzzle:
+		  the sum of the largest distance any tile can be from its placement over
+		  every tile, and ten for every cell*/
+		static const int MAX_SUM = (CELLS - 1) * (R - 1 + C - 1);
+		static const int SCALE = 10 * CELLS;
 	private:
-		int puzzle[16];
-		//checks if two puzzles are equal
-		int equals(fifteen_puzzle n){
-			for(int i = 0; i < 16; i++){
-				if(n.puzzle[i] != puzzle[i])	return 0;
+		word board;
+		//zobrist hash of the board, updated by swap along with the board
+		uint64_t zobrist;
+		//cached index of the empty tile
+		int zero;
+		//cached sum of the manhatten distances of every non-empty tile,
+		//updated by swap as the single moved tile changes places
+		int distance;
+
+		//returns the field of the board at index i
+		static int tile(word b, int i){
+			return (int)((b >> (i * BITS)) & ((1 << BITS) - 1));
+		}
+		//translates a move letter into the index offset of the tile that moves
+		//into the empty space, 0 for letters that are not moves
+		static int offset(char a){
+			switch(a){
+				case 'u':
+				case 'U':
+					return -C;
+				case 'd':
+				case 'D':
+					return C;
+				case 'l':
+				case 'L':
+					return -1;
+				case 'r':
+				case 'R':
+					return 1;
+				default:
+					return 0;
 			}
-			return 1;
 		}
 		/*this function tests whether a move is successful by deciding the probability
 		  of a successful move based on a function and the move type, as given by
-		  the current location of the empty tile and the move direction. then a random 
+		  the current location of the empty tile and the move direction. then a random
 		  roll decides if the move was successful given the odds provided for each move*/
 		int swap_success(int zero_tile, char move){
-			int move_id = move;
-			//the calculation below for odds returns an integer ranging
-			//from 1 to 85, by messing around with it, im happy with the average
-			//odds of a successful move being 36. these integers can be thought of
-			//as percentages
-			int odds = ((15 + ((int)move % (zero_tile + 5))
-				   *((int)move % (zero_tile + 4))) % 100);
 			//this rand() line relies on the main program already seeding rand()
 			int roll = rand()%100 + 1;
-			if(roll < odds)	return 0;	//returns 0 if the random roll was lower than odds of success
+			//the odds come from the lookup, the move having already been checked
+			if(roll < lookup.odds[zero_tile][move_index(move)])	return 0;	//returns 0 if the random roll was lower than odds of success
 			return 1;	//returns 1 if random roll met or exceeded odds for a given move
 		}
+		//same as above, but rolling with a search's own generator instead of rand()
+		int swap_success(int zero_tile, char move, xoshiro256& rng){
+			int roll = rng.below(100) + 1;
+			if(roll < lookup.odds[zero_tile][move_index(move)])	return 0;
+			return 1;
+		}
+		//moves the tile next to the empty space in the direction of the action
+		//into the empty space, the action must already be a valid swap
+		void slide(char action){
+			//the tile is moved into the empty space's field, and its old field is cleared
+			int next = zero + offset(action);
+			int moved = tile(board, next);
+			board ^= ((word)moved << (next * BITS)) | ((word)moved << (zero * BITS));
+			//only the moved tile changes distance
+			distance += lookup.distance[moved][zero] - lookup.distance[moved][next];
+			//the moved tile and the empty tile trade fields
+			zobrist ^= lookup.key[moved][next] ^ lookup.key[moved][zero]
+				 ^ lookup.key[0][zero] ^ lookup.key[0][next];
+			zero = next;
+		}
 		//private constructor used by avg_heuristic for testing purposes
 		void scramble(){
-			int temp;
+			int puzzle[CELLS];
 			int r;
-			for(int i = 0; i < 16; i++)	puzzle[i] = i;
-			for(int i = 0; i < 16; i++){
-				r = rand()%16;
+			for(int i = 0; i < CELLS; i++)	puzzle[i] = i;
+			for(int i = 0; i < CELLS; i++){
+				r = rand()%CELLS;
 				int temp = puzzle[i];
 				puzzle[i] = puzzle[r];
 				puzzle[r] = temp;
 			}
+			pack(puzzle);
+		}
+		//builds the packed board and every cached value from the tiles
+		void pack(const int* puzzle){
+			board = 0;
+			zobrist = 0;
+			zero = 0;
+			distance = 0;
+			for(int i = 0; i < CELLS; i++){
+				board |= (word)puzzle[i] << (i * BITS);
+				zobrist ^= lookup.key[puzzle[i]][i];
+				distance += lookup.distance[puzzle[i]][i];
+				if(puzzle[i] == 0)	zero = i;
+			}
 		}
 
 	public:
+		//odds used by swap_success, a roll of 1 to 100 below them fails the move
+		static constexpr int odds(int zero_tile, char move){
+			return move_odds(zero_tile, move);
+		}
+		//chance that move map[m] succeeds with the empty tile at index zero_tile
+		static double success_chance(int zero_tile, int m){
+			return lookup.chance[zero_tile][m];
+		}
+		//checks if two puzzles are equal
+		int equals(const sliding_puzzle& n) const{
+			return n.board == board;
+		}
 		//standard constructor
-		fifteen_puzzle(){
-			for(int i = 0; i < 16; i++)	puzzle[i] = 0;
+		sliding_puzzle(){
+			board = 0;
+			zobrist = 0;
+			zero = 0;
+			distance = 0;
 		}
 
 		//constructor that returns a new puzzle given an old puzzle and a move to make on it
 		//this is used to create children in the tree, to successfull swaps are needed
-                fifteen_puzzle(fifteen_puzzle p, char a){
-                        //puzzle = new int[16];
-                        for(int i = 0; i < 16; i++)
-                                puzzle[i] = p.at(i);
+		sliding_puzzle(sliding_puzzle p, char a){
+			copy(p);
 			if(!valid_swap(a)){
 				exit(0);
-			}	
-                        while(!(swap(a)));
-                }
+			}
+			while(!(swap(a)));
+		}
 
 		//same as constructor above, but using an integer index for letters
 		//0 is U, 1 is D, 2 is L, 3 is R
-		fifteen_puzzle(fifteen_puzzle p, int index){
-			//puzzle = new int[16];
-			for(int i = 0; i < 16; i++)
-				puzzle[i] = p.at(i);
+		sliding_puzzle(sliding_puzzle p, int index){
+			copy(p);
 			while(!(swap(map[index])));//exit(0);
 		}
 		//copy constructor
-		fifteen_puzzle(const fifteen_puzzle& p){
-			//puzzle = new int[16];
-			for(int i = 0; i < 16; i++){
-				puzzle[i] = p.at(i);
-			}
+		sliding_puzzle(const sliding_puzzle& p){
+			copy(p);
 		}
 		//equals operator overload
-		fifteen_puzzle operator=(const fifteen_puzzle& p){
-			fifteen_puzzle q(p);
-			return q;
+		sliding_puzzle& operator=(const sliding_puzzle& p){
+			copy(p);
+			return *this;
 		}
 
 		//overload that allows for integer input on method below
@@ -103,216 +282,325 @@ class fifteen_puzzle{
 		//not to be confused with swap_success, which decides if an
 		//already valid swap is randomly successful
 		int valid_swap(char a) const{
-			sanity(102);	
-			//finding empty tile
-			int i = 0;
-			for(i = 0; i < 16; i++)
-				if(puzzle[i] == 0)	break;
 			switch(a){
 				//to move up, cannot be in top row
 				case 'u':
 				case 'U':
-					if(i < 4)	return 0;
-					break;
+					return zero >= C;
 				//to move down, cannot be in bottom row
 				case 'd':
 				case 'D':
-					if(i > 11)	return 0;
-					break;
+					return zero < CELLS - C;
 				//to move left, cannot be in leftmost column
 				case 'l':
 				case 'L':
-					if(i % 4 == 0)	return 0;
-					break;
+					return (unsigned)zero % C != 0;
 				//to move right, cannot be in rightmost column
 				case 'r':
 				case 'R':
-					if(i % 4 == 3)	return 0;
-					break;
+					return (unsigned)zero % C != C - 1;
 				//if letter is entered that is not a valid move
 				//letter, then the move cannot be valid
 				default:
 					return 0;
 			}
-			sanity(133);
-			//if switch is exited, move is valid given board configuration
-			return 1;
-		}	
+		}
+		//checks that a packed word, such as one read back from a file, holds
+		//every tile from 0 to CELLS - 1 exactly once, as unpacked needs it to
+		static bool valid_packed(word b){
+			uint64_t seen = 0;
+			for(int i = 0; i < CELLS; i++){
+				int t = tile(b, i);
+				if(t >= CELLS || (seen >> t) & 1)	return false;
+				seen |= (uint64_t)1 << t;
+			}
+			return true;
+		}
+		//builds a board from its packed word, such as one read back from a file
+		static sliding_puzzle unpacked(word b){
+			int puzzle[CELLS];
+			for(int i = 0; i < CELLS; i++)	puzzle[i] = tile(b, i);
+			sliding_puzzle p;
+			p.pack(puzzle);
+			return p;
+		}
+		//getter for the packed board, which also serves as an exact key
+		word packed() const{
+			return board;
+		}
+		//getter for the zobrist hash of the board
+		uint64_t hash() const{
+			return zobrist;
+		}
+		//getter for the index of the empty tile
+		int blank() const{
+			return zero;
+		}
+		//getter for the sum of the manhatten distances of every tile
+		int manhatten() const{
+			return distance;
+		}
 		//simple getter that returns value at a given index
 		int at(int index) const{
-			if(index < 0 || index > 15)	return -1;
-			return puzzle[index];
+			if(index < 0 || index > CELLS - 1)	return -1;
+			return tile(board, index);
 		}
 		//prints out puzzle board
 		void print() const{
-			if(puzzle == NULL){
-				cout<<"NULL puzzle sent to print"<<endl;
-				return;
+			for(int i = 0; i < CELLS; i++){
+				cout<<at(i)<<"\t";
+				if(i%C == C - 1) cout<<"\n";
 			}
-                        for(int i = 0; i < 16; i++){
-                                cout<<puzzle[i]<<"\t";
-                                if(i%4 == 3) cout<<"\n";
-                        }
 			cout<<endl;
-                }
-		//method testing for goal
+		}
+		//the heuristic the board would have after the valid move map[m]
+		//succeeded, worked out without making the move
+		double heuristic_after(int m) const{
+			int next = zero + offset(map[m]);
+			int moved = tile(board, next);
+			if((board ^ ((word)moved << (next * BITS)) ^ ((word)moved << (zero * BITS))) == lookup.goal)
+				return 1000;
+			double value = MAX_SUM - (distance + lookup.distance[moved][zero]
+						  - lookup.distance[moved][next]);
+			return value / SCALE;
+		}
+		//the board the valid move map[m] lands on when it succeeds
+		sliding_puzzle after(int m) const{
+			sliding_puzzle next(*this);
+			next.slide(map[m]);
+			return next;
+		}
+		//method testing for goal, the goal being tiles 1 through the last in order
+		//followed by the empty tile
 		bool goal_test() const{
-			for(int i = 0; i < 16; i++)
-				if(puzzle[i] != i + 1)	return false;
-			return true;
+			return board == lookup.goal;
 		}
 //NOTE: Heuristic function is subject to change, currently returns 0 for non-goal states,
 //it may return some small value for near-goal states in the future
 		//method that returns a heuristic value associated with the puzzle configuration
 		//UCB1 is only convergent
-                double heuristic() const{
-			bool goal = true;
-                        for(int i = 0; i < 16; i++)
-                                if(puzzle[i] != i + 1)
-                                        goal = false;
-			
-			if(goal)	return 1000;
-                        //if not a goal, calculates and returns heuristic
-			int heuristic = 0;
+		double heuristic() const{
+			if(goal_test())	return 1000;
+			//if not a goal, calculates and returns heuristic
 			/*since mcts will assign value and higher value is better,
 		 	  the heuristic used will be an inverse manhatten distance
-			  scoring, where more points will be given to tiles closer 
+			  scoring, where more points will be given to tiles closer
 			  to their proper placement.
-			
+
 			  The maximum manhatten distance in a 4x4 puzzle is 6, if a tile's
 			  designated space is one of the corners, and its current placement
 			  is the opposite corner. So the heuristic will be 6 - manhatten distance
-			
-			  however, since the values will compound in the tree search, smaller 
+
+			  however, since the values will compound in the tree search, smaller
 			  values are needed to avoid overflow
+
+			  the sum of (6 - manhatten distance) over the 15 tiles is 90 minus the
+			  cached sum of manhatten distances, which swap keeps up to date,
+			  other sizes using their own largest distance in place of 6
 			*/
-			int manhatten = 0;
-			double value = 0;
-			int column_difference = 0;
-			int row_difference = 0;
-			/*this loop computes each manhatten distance in constant time
-			  then adds  their inverses to value;
-			  the computation uses division and the mod operator to find
-			  the differences between row and column between a tile's current 
-			  index (i) and its correct location (v-1), as defined by:
-			  |(v-1) % 4 - i % 4| + |(v-1) / 4 + i / 4|
-			*/
-			for(int i = 0; i < 16; i++){
-				//skipping empty tile
-				if(puzzle[i] == 0)	continue;
-				//line that computes absolute value (v-1 % 4 + i % 4)
-				column_difference = (i % 4 > (puzzle[i] - 1) % 4) 
-						    ? i % 4 - (puzzle[i] - 1) % 4
-						    : (puzzle[i] - 1) % 4 - i % 4;
-				//line that computes absolute value (v-1 / 4 + i / 4)
-                                row_difference = (i / 4 > (puzzle[i] - 1) / 4) 
-                                                    ? i / 4 - (puzzle[i] - 1) / 4
-                                                    : (puzzle[i] - 1) / 4 - i / 4;
-				manhatten = row_difference + column_difference;
-				value += (6.0 - manhatten);
-				
-			}
+			double value = MAX_SUM - distance;
 
 			//NOTE: cutoff implementation is not being used, instead a vary small value
 			//by dividing heuristic
-			return value / 160;
+			return value / SCALE;
 			//returning some points if close to correct answer i.e. meets a heuristic cutoff
 			//cutoff is defined at the top of the file
 			//if(value >= cutoff)	return 0.5;
 			//return 0.0;
-                }
+		}
+
 
-		
 		//swaps two pieces on the board using U, D, L, R for Up, Down, Left, and Right
 		//returns 0 for unsuccessful swaps,
 		//which is decided nondeterministically by the swap_success function
 		int swap(char action){
-			sanity(218);
 			//first checking if valid move
 			if(!valid_swap(action))	return 0;
-			
-			//finding 0/empty tile
-                        int i = 0;
-                        int temp;
-                        for (i = 0; i < 16; i++)
-                                if(puzzle[i] == 0) break;
-                        temp = puzzle[i];
 
 			//checking if the move is a failure or not
-			if(!swap_success(i, action))	return 0;
-			//if not a failure, perform the swap below
-
-                        //switch statement which swaps empty tile based on action
-                        switch(action){
-                                case 'U':
-                                        puzzle[i] = puzzle[i-4];
-                                        puzzle[i-4] = temp;
-                                        break;
-                                case 'D':
-                                        puzzle[i] = puzzle[i+4];
-                                        puzzle[i+4] = temp;
-                                        break;
-                                case 'L':
-                                        puzzle[i] = puzzle[i-1];
-                                        puzzle[i-1] = temp;
-                                        break;
-                                case 'R':
-                                        puzzle[i] = puzzle[i+1];
-                                        puzzle[i+1] = temp;
-                                default:
-                                        break;
-                        }
+			if(!swap_success(zero, action))	return 0;
+			//if not a failure, perform the swap
+			slide(action);
 			return 1;
-                }
-		
+		}
+		//same as above, but the success roll is drawn from a search's generator
+		int swap(char action, xoshiro256& rng){
+			if(!valid_swap(action))	return 0;
+			if(!swap_success(zero, action, rng))	return 0;
+			slide(action);
+			return 1;
+		}
+
 		//copies from a sent puzzle
-		void copy(const fifteen_puzzle& p){
-			sanity(270);
-			//clear();
-			//puzzle = new int[16];
-			for(int i = 0; i< 16; i++){
-				puzzle[i] = p.at(i);
-			}
+		void copy(const sliding_puzzle& p){
+			board = p.board;
+			zobrist = p.zobrist;
+			zero = p.zero;
+			distance = p.distance;
 		}
 
-		//contructor for a root fifteen_puzzle ggiven a first puzzle to copy
-                fifteen_puzzle(int* input){
-                        //puzzle = new int[16];
+		//contructor for a root sliding_puzzle ggiven a first puzzle to copy
+		sliding_puzzle(int* input){
+			board = 0;
+			zobrist = 0;
+			zero = 0;
+			distance = 0;
 			if(input != NULL){
-				for(int i = 0; i < 16; i++)
-					puzzle[i] = input[i];
+				for(int i = 0; i < CELLS; i++){
+					if(input[i] > CELLS - 1 || input[i] < 0){
+						cout<<"PUZZLE INPUT OUT OF RANGE AT INDEX "
+						    <<i<<". EXITING."<<endl;
+						exit(0);
+					}
+				}
+				pack(input);
 			}
-                }
+		}
 		//debugging method
 		void sanity(int line) const{
-			for(int i = 0; i < 16; i++){
-				if(puzzle[i] > 15 || puzzle[i] < 0){
-					cout<<"PUZZLE FAILED SANITY CHECK ON LINE "
-					    <<line<<". PRINTING AND EXITING."<<endl;
-					print();
-					exit(0);
-				}
+			if(tile(board, zero) != 0){
+				cout<<"PUZZLE FAILED SANITY CHECK ON LINE "
+				    <<line<<". PRINTING AND EXITING."<<endl;
+				print();
+				exit(0);
 			}
 		}
 		//method only for testing, may be removed later
 		void avg_heuristic(){
 			//this method loops through testing random board configurations to find
-			//the average value being returned by heuristic()
-			int iterations = 2000;
+			//the average value being returned by heuristic(), scoring fifteen
+			//puzzles all at once with batch_heuristic
+			const int iterations = 2000;
+			double values[iterations];
 			double total = 0.0;
 			int cutoff_count = 0;
+			if constexpr(R == 4 && C == 4){
+				uint64_t boards[iterations];
+				for(int i = 0; i < iterations; i++){
+					scramble();
+					boards[i] = board;
+				}
+				batch_heuristic(boards, iterations, values);
+			}
+			else{
+				for(int i = 0; i < iterations; i++){
+					scramble();
+					values[i] = heuristic();
+				}
+			}
 			for(int i = 0; i < iterations; i++){
-				scramble();
-				total += heuristic();
+				total += values[i];
 				//cutoff is defined at the top of the file
-				if(heuristic() >= cutoff)	cutoff_count++;
+				if(values[i] >= cutoff)	cutoff_count++;
 			}
 			cout<<"AVERAGE HEURISTIC OVER "<<iterations<<" ITERATIONS IS "
 						       <<total/iterations<<endl;
 			cout<<"NUMBER ABOVE "<<cutoff<<": "<<cutoff_count<<endl;
 		}
-		
+
+};
+
+//the sizes the solver is built for
+typedef sliding_puzzle<3, 3> eight_puzzle;
+typedef sliding_puzzle<4, 4> fifteen_puzzle;
+typedef sliding_puzzle<5, 5> twenty_four_puzzle;
+
+/*	Batch heuristic:
+	scores arrays of packed boards from scratch, giving exactly what
+	fifteen_puzzle::heuristic() gives for each of them. Each board's sixteen
+	nibbles are spread into sixteen bytes, two boards to an AVX2 register, so
+	the target row and column of every tile come from one byte shuffle each
+	against the tables below, and the sixteen distances are summed with a
+	single sum of absolute differences. Machines without AVX2, and the last
+	few boards of an array, go through the scalar lookup path.
+*/
+struct heuristic_tables{
+	//target row and column of each tile, then the row and column of each index,
+	//all repeated for both 128 bit halves of a register
+	alignas(32) char target_row[32];
+	alignas(32) char target_col[32];
+	alignas(32) char index_row[32];
+	alignas(32) char index_col[32];
+	constexpr heuristic_tables() : target_row(), target_col(), index_row(), index_col(){
+		for(int j = 0; j < 32; j++){
+			int v = j & 15;
+			target_row[j] = v == 0 ? 0 : (v - 1) / 4;
+			target_col[j] = v == 0 ? 0 : (v - 1) % 4;
+			index_row[j] = v / 4;
+			index_col[j] = v % 4;
+		}
+	}
 };
+constexpr heuristic_tables heuristic_lookup;
 
+//scalar path, the sum of every tile's manhatten distance read from the lookup
+inline int manhatten_sum(uint64_t board){
+	int sum = 0;
+	for(int i = 0; i < 16; i++)
+		sum += fifteen_puzzle::lookup.distance[(board >> (i << 2)) & 0xF][i];
+	return sum;
+}
+//scalar path for one board, the same formula as fifteen_puzzle::heuristic()
+inline double packed_heuristic(uint64_t board){
+	if(board == goal_board)	return 1000;
+	double value = 90 - manhatten_sum(board);
+	return value / 160;
+}
 
+//sums of the manhatten distances of the two boards spread over x, returned
+//as two 64 bit partial sums per board
+__attribute__((target("avx2")))
+inline __m256i manhatten_halves(__m256i x){
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i rows = _mm256_load_si256((const __m256i*)heuristic_lookup.target_row);
+	__m256i cols = _mm256_load_si256((const __m256i*)heuristic_lookup.target_col);
+	__m256i index_rows = _mm256_load_si256((const __m256i*)heuristic_lookup.index_row);
+	__m256i index_cols = _mm256_load_si256((const __m256i*)heuristic_lookup.index_col);
+	__m256i row_difference = _mm256_abs_epi8(_mm256_sub_epi8(_mm256_shuffle_epi8(rows, x), index_rows));
+	__m256i column_difference = _mm256_abs_epi8(_mm256_sub_epi8(_mm256_shuffle_epi8(cols, x), index_cols));
+	__m256i distance = _mm256_add_epi8(row_difference, column_difference);
+	//skipping the empty tile
+	distance = _mm256_andnot_si256(_mm256_cmpeq_epi8(x, zero), distance);
+	return _mm256_sad_epu8(distance, zero);
+}
+//scores boards four at a time, returning how many boards were scored
+__attribute__((target("avx2")))
+inline int batch_heuristic_avx2(const uint64_t* boards, int n, double* out){
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	alignas(32) long long sums[4];
+	int i = 0;
+	for(; i + 4 <= n; i += 4){
+		__m256i v = _mm256_loadu_si256((const __m256i*)&boards[i]);
+		__m256i low = _mm256_and_si256(v, nibble);
+		__m256i high = _mm256_and_si256(_mm256_srli_epi64(v, 4), nibble);
+		//bytes in index order, boards i and i + 2 in a, i + 1 and i + 3 in b
+		__m256i a = manhatten_halves(_mm256_unpacklo_epi8(low, high));
+		__m256i b = manhatten_halves(_mm256_unpackhi_epi8(low, high));
+		//adding the partial sums back into board order i to i + 3
+		__m256i sum = _mm256_add_epi64(_mm256_unpacklo_epi64(a, b), _mm256_unpackhi_epi64(a, b));
+		_mm256_store_si256((__m256i*)sums, sum);
+		for(int k = 0; k < 4; k++){
+			double value = 90 - sums[k];
+			out[i + k] = boards[i + k] == goal_board ? 1000 : value / 160;
+		}
+	}
+	return i;
+}
+inline void batch_heuristic(const uint64_t* boards, int n, double* out){
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	int i = 0;
+	if(avx2)	i = batch_heuristic_avx2(boards, n, out);
+	for(; i < n; i++)	out[i] = packed_heuristic(boards[i]);
+}
+//same as above for an array of puzzles
+inline void batch_heuristic(const fifteen_puzzle* puzzles, int n, double* out){
+	const int chunk = 256;
+	uint64_t boards[chunk];
+	for(int i = 0; i < n; i += chunk){
+		int count = n - i < chunk ? n - i : chunk;
+		for(int k = 0; k < count; k++)	boards[k] = puzzles[i + k].packed();
+		batch_heuristic(boards, count, out + i);
+	}
+}
 
+#endif
@@ -0,0 +1,66 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/*bounded_queue class:
+	blocking first in first out queue of limited size, for handing work from
+	one thread to a pool of others. push() waits while the queue is full, so a
+	producer reading a long input never gets more than capacity items ahead of
+	the consumers. Once close() is called, pop() drains whatever is left and
+	then returns false, telling the consumers to finish.
+*/
+template <class T>
+class bounded_queue{
+	private:
+		std::deque<T> items;
+		size_t capacity;
+		bool closed;
+		std::mutex lock;
+		std::condition_variable not_full;
+		std::condition_variable not_empty;
+	public:
+		bounded_queue(size_t capacity){
+			this->capacity = capacity < 1 ? 1 : capacity;
+			closed = false;
+		}
+		bounded_queue(const bounded_queue&) = delete;
+		bounded_queue& operator=(const bounded_queue&) = delete;
+
+		//adds an item, waiting for room, returns false if the queue was closed
+		bool push(const T& item){
+			std::unique_lock<std::mutex> guard(lock);
+			not_full.wait(guard, [this]{ return closed || items.size() < capacity; });
+			if(closed)	return false;
+			items.push_back(item);
+			not_empty.notify_one();
+			return true;
+		}
+		//takes the oldest item, waiting for one, returns false once the
+		//queue is closed and empty
+		bool pop(T& item){
+			std::unique_lock<std::mutex> guard(lock);
+			not_empty.wait(guard, [this]{ return closed || !items.empty(); });
+			if(items.empty())	return false;
+			item = items.front();
+			items.pop_front();
+			not_full.notify_one();
+			return true;
+		}
+		//items waiting to be taken
+		size_t size(){
+			std::lock_guard<std::mutex> guard(lock);
+			return items.size();
+		}
+		//no more items will be pushed
+		void close(){
+			std::lock_guard<std::mutex> guard(lock);
+			closed = true;
+			not_full.notify_all();
+			not_empty.notify_all();
+		}
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+//splitmix64, used to spread a single seed over a generator's state or key
+inline uint64_t splitmix(uint64_t& x){
+	uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*xoshiro256 class:
+	small, fast pseudo random number generator (xoshiro256** by Blackman and Vigna)
+	used in place of rand() inside the search. Every search owns its own generator,
+	so there is no hidden global state and no locking, and a search seeded with the
+	same value always makes the same random choices.
+*/
+class xoshiro256{
+	private:
+		uint64_t s[4];
+
+		static uint64_t rotl(uint64_t x, int k){
+			return (x << k) | (x >> (64 - k));
+		}
+	public:
+		xoshiro256(uint64_t seed = 0){
+			this->seed(seed);
+		}
+		//starts from the given state words, any but all zero
+		xoshiro256(const uint64_t state[4]){
+			for(int i = 0; i < 4; i++)	s[i] = state[i];
+			if((s[0] | s[1] | s[2] | s[3]) == 0)	s[0] = 1;
+		}
+		//the seed is spread over the four state words with splitmix64,
+		//since xoshiro must never be seeded with an all zero state
+		void seed(uint64_t seed){
+			for(int i = 0; i < 4; i++)	s[i] = splitmix(seed);
+		}
+		//returns the next 64 random bits
+		uint64_t next(){
+			uint64_t result = rotl(s[1] * 5, 7) * 9;
+			uint64_t t = s[1] << 17;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = rotl(s[3], 45);
+			return result;
+		}
+		//returns a random integer in [0, n), using the high bits of the
+		//generator and a multiply instead of the slow and biased modulo
+		int below(int n){
+			return (int)(((next() >> 32) * (uint64_t)n) >> 32);
+		}
+		//returns a random double in [0, 1) from the top 53 bits
+		double unit(){
+			return (next() >> 11) * 0x1.0p-53;
+		}
+};
+
+/*philox class:
+	counter based generator (Philox4x32-10 by Salmon et al.), whose output is
+	a keyed hash of a 128 bit counter rather than the next step of a state,
+	so any point of it can be reached directly. The key comes from the seed.
+	Drawing every number from it would cost a hash for every four words, so
+	instead stream() hashes a move number and an iteration index into the
+	state of a xoshiro256 that the iteration draws from. An iteration then
+	draws the same numbers whichever thread runs it and however many
+	iterations ran before it, and any one iteration of a game can be
+	replayed from the seed alone.
+*/
+class philox{
+	private:
+		uint32_t key[2];
+	public:
+		//hashes the counter in place, ten rounds of two multiplies each, the
+		//counter's first word being Random123's ctr[0]
+		void hash(uint32_t* c) const{
+			uint32_t k0 = key[0], k1 = key[1];
+			for(int r = 0; r < 10; r++){
+				uint64_t p0 = (uint64_t)0xD2511F53U * c[0];
+				uint64_t p1 = (uint64_t)0xCD9E8D57U * c[2];
+				c[0] = (uint32_t)(p1 >> 32) ^ c[1] ^ k0;
+				c[1] = (uint32_t)p1;
+				c[2] = (uint32_t)(p0 >> 32) ^ c[3] ^ k1;
+				c[3] = (uint32_t)p0;
+				k0 += 0x9E3779B9U;
+				k1 += 0xBB67AE85U;
+			}
+		}
+		philox(uint64_t seed = 0){
+			this->seed(seed);
+		}
+		void seed(uint64_t seed){
+			uint64_t k = splitmix(seed);
+			key[0] = (uint32_t)k;
+			key[1] = (uint32_t)(k >> 32);
+		}
+		//sets the key itself rather than from a seed, for checking hash
+		//against published known answers
+		void set_key(uint32_t k0, uint32_t k1){
+			key[0] = k0;
+			key[1] = k1;
+		}
+		//the generator for the given iteration of the given move, its state
+		//being the hashes of two counters holding them
+		xoshiro256 stream(uint32_t move, uint32_t iteration) const{
+			uint64_t state[4];
+			for(uint32_t half = 0; half < 2; half++){
+				uint32_t c[4] = {half, 0, iteration, move};
+				hash(c);
+				state[half * 2] = ((uint64_t)c[0] << 32) | c[1];
+				state[half * 2 + 1] = ((uint64_t)c[2] << 32) | c[3];
+			}
+			return xoshiro256(state);
+		}
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <iostream>
+#include <chrono>
+
+/*	Search statistics:
+	counters and phase timers for the hot paths of the search, kept per search
+	context so that no thread ever writes to another's. Building with
+	-DMCTS_NO_STATS (make nostats) compiles every counter update and timer
+	out of the search, leaving the struct in place but always empty.
+
+	The counters are the walks' steps, their nondeterministic swap failures,
+	the moves random_walk rerolled because they were invalid, and the depth of
+	every leaf reached by selection. The timers split each mcts() iteration
+	into selection, expansion, rollout and backpropagation. Walks run by the
+	batched kernel count their steps but not their failures, and each batch
+	adds the variance of its mean, per step, so the summaries show how much
+	batching steadies the values backpropagated.
+*/
+
+#ifdef MCTS_NO_STATS
+#define STATS_ENABLED false
+#define STAT(statement)
+#else
+#define STATS_ENABLED true
+#define STAT(statement) statement
+#endif
+
+struct search_stats{
+	long long rollout_steps;
+	long long swap_failures;
+	long long invalid_retries;
+	//leaves reached by selection, the sum of their depths and the deepest
+	long long leaves;
+	long long depth_total;
+	int max_depth;
+	//batches of walks run and the sum of the variances of their means
+	long long batches;
+	double batch_variance;
+	//nanoseconds spent in each phase of mcts()
+	long long select_ns;
+	long long expand_ns;
+	long long rollout_ns;
+	long long backprop_ns;
+
+	search_stats(){
+		clear();
+	}
+	void clear(){
+		rollout_steps = 0;
+		swap_failures = 0;
+		invalid_retries = 0;
+		leaves = 0;
+		depth_total = 0;
+		max_depth = 0;
+		batches = 0;
+		batch_variance = 0;
+		select_ns = 0;
+		expand_ns = 0;
+		rollout_ns = 0;
+		backprop_ns = 0;
+	}
+	void add(const search_stats& s){
+		rollout_steps += s.rollout_steps;
+		swap_failures += s.swap_failures;
+		invalid_retries += s.invalid_retries;
+		leaves += s.leaves;
+		depth_total += s.depth_total;
+		if(s.max_depth > max_depth)	max_depth = s.max_depth;
+		batches += s.batches;
+		batch_variance += s.batch_variance;
+		select_ns += s.select_ns;
+		expand_ns += s.expand_ns;
+		rollout_ns += s.rollout_ns;
+		backprop_ns += s.backprop_ns;
+	}
+	//the counts gathered since an earlier snapshot, the deepest leaf being
+	//left as is, since searches start it over for every move
+	search_stats since(const search_stats& before) const{
+		search_stats s = *this;
+		s.rollout_steps -= before.rollout_steps;
+		s.swap_failures -= before.swap_failures;
+		s.invalid_retries -= before.invalid_retries;
+		s.leaves -= before.leaves;
+		s.depth_total -= before.depth_total;
+		s.batches -= before.batches;
+		s.batch_variance -= before.batch_variance;
+		s.select_ns -= before.select_ns;
+		s.expand_ns -= before.expand_ns;
+		s.rollout_ns -= before.rollout_ns;
+		s.backprop_ns -= before.backprop_ns;
+		return s;
+	}
+	//writes the counters as fields of a JSON object, each preceded by a comma,
+	//or nothing when statistics are compiled out
+	void print_fields(std::ostream& out) const{
+		if(!STATS_ENABLED)	return;
+		out<<",\"rollout_steps\":"<<rollout_steps
+		   <<",\"swap_failures\":"<<swap_failures
+		   <<",\"invalid_retries\":"<<invalid_retries
+		   <<",\"max_depth\":"<<max_depth
+		   <<",\"mean_depth\":"<<(leaves == 0 ? 0 : (double)depth_total / leaves)
+		   <<",\"batches\":"<<batches
+		   <<",\"batch_variance\":"<<(batches == 0 ? 0 : batch_variance / batches)
+		   <<",\"select_ms\":"<<select_ns / 1e6
+		   <<",\"expand_ms\":"<<expand_ns / 1e6
+		   <<",\"rollout_ms\":"<<rollout_ns / 1e6
+		   <<",\"backprop_ms\":"<<backprop_ns / 1e6;
+	}
+};
+
+//nanoseconds on the steady clock, for the phase timers
+inline long long stat_clock(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
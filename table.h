@@ -0,0 +1,127 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <cstdint>
+#include <vector>
+#include "puzzlefile.h"
+
+/*transposition_table class:
+	a fixed size hash table holding visit and value statistics per board, so
+	boards reached by different paths through the tree (such as U followed by D
+	landing back on the parent's board) share what has been learned about them.
+	The search reads an entry only as a prior on a new node's value, so visits
+	made along other paths never count as visits of the node itself.
+	Boards are placed by their zobrist hash into buckets of four entries and
+	confirmed by their packed board, the table being built for one puzzle size. When a bucket is full, the entry left over
+	from the oldest search is replaced first, and among those the least visited.
+*/
+template <class P>
+struct tt_entry{
+	//packed board, 0 for an empty entry since no real board packs to 0
+	typename P::word board;
+	double total_val;
+	int visits;
+	//search the entry was last updated in
+	int generation;
+};
+
+template <class P>
+class transposition_table{
+	private:
+		static const int BUCKET = 4;
+		std::vector<tt_entry<P>> entries;
+		uint64_t mask;
+		int generation;
+		//counters for reporting how well the table is doing
+		uint64_t probes;
+		uint64_t hits;
+		uint64_t stores;
+		uint64_t replacements;
+
+		tt_entry<P>* bucket(const P& p){
+			return &entries[(p.hash() & mask) * BUCKET];
+		}
+	public:
+		//capacity is rounded down to a power of two number of buckets
+		transposition_table(size_t capacity){
+			size_t buckets = 1;
+			while(buckets * 2 * BUCKET <= capacity)	buckets *= 2;
+			entries.assign(buckets * BUCKET, tt_entry<P>());
+			mask = buckets - 1;
+			generation = 0;
+			probes = hits = stores = replacements = 0;
+		}
+		//empties the table for a search from an unrelated board
+		void clear(){
+			entries.assign(entries.size(), tt_entry<P>());
+			generation = 0;
+		}
+		//called before each real move's search, so older entries are replaced first
+		void new_search(){
+			generation++;
+		}
+		//returns the entry for a board, or NULL if the board is not in the table
+		const tt_entry<P>* probe(const P& p){
+			probes++;
+			tt_entry<P>* b = bucket(p);
+			for(int i = 0; i < BUCKET; i++){
+				if(b[i].board == p.packed()){
+					hits++;
+					return &b[i];
+				}
+			}
+			return NULL;
+		}
+		//adds one visit and the given value to a board's entry, making room for
+		//the board if it is not in the table yet
+		void update(const P& p, double value){
+			stores++;
+			tt_entry<P>* b = bucket(p);
+			tt_entry<P>* victim = &b[0];
+			for(int i = 0; i < BUCKET; i++){
+				if(b[i].board == p.packed()){
+					victim = &b[i];
+					break;
+				}
+				if(b[i].board == 0){
+					victim = &b[i];
+					break;
+				}
+				//older searches first, then fewest visits
+				if(b[i].generation < victim->generation
+				   || (b[i].generation == victim->generation
+				       && b[i].visits < victim->visits))
+					victim = &b[i];
+			}
+			if(victim->board != p.packed()){
+				if(victim->board != 0)	replacements++;
+				victim->board = p.packed();
+				victim->total_val = 0;
+				victim->visits = 0;
+			}
+			victim->total_val += value;
+			victim->visits++;
+			victim->generation = generation;
+		}
+		size_t capacity() const{
+			return entries.size();
+		}
+		uint64_t probe_count() const{
+			return probes;
+		}
+		uint64_t hit_count() const{
+			return hits;
+		}
+		uint64_t store_count() const{
+			return stores;
+		}
+		uint64_t replacement_count() const{
+			return replacements;
+		}
+		double hit_rate() const{
+			if(probes == 0)	return 0;
+			return (double)hits / probes;
+		}
+};
+
+#endif
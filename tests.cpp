@@ -0,0 +1,334 @@
+/*	tests.cpp
+	Regression tests for the search, built and run with make test. Each test
+	prints its name and whether it passed, and the program exits with 1 if
+	any of them failed.
+
+	Early stop on a kept subtree:
+		grows a tree from a board, moves on to the most visited root child so
+		that the kept subtree starts the next search with its own children
+		far apart in visits, then searches again with early stopping. The
+		lead carried over from the first search must not stop the second
+		one, which has to run at least EARLY_STOP_ITERATIONS iterations.
+		Run with both the root parallel and the shared tree search.
+
+	Corrupt checkpoints:
+		saves a searched tree, checks that it loads back whole, then loads
+		copies with one of the root's children rewritten, once with tiles no
+		board holds and once with another real board. Both have to be
+		rejected with an error, leaving a fresh root that can be searched.
+
+	Philox known answers:
+		the counter based generator's hash against the Philox4x32-10 known
+		answer vectors published with Random123.
+
+	Replicas on any number of threads:
+		plays the same game with a fixed number of replicas on one, two and
+		four threads, limited by iterations, and checks that every move's
+		merged root visits and choice are the same each time.
+
+	Batched rollout kernels:
+		runs the same batches of walks, from the same generator state, with
+		the AVX2 and the scalar kernel, from several boards and for batch
+		sizes that do and do not fill whole registers, and checks that the
+		means and variances are exactly equal. Skipped when the machine has
+		no AVX2, the scalar kernel then being the only one.
+
+	Node budget:
+		plays several moves with a node budget far smaller than the searches
+		would grow, checking that the budget was reached, evicting subtrees
+		or, for the shared tree, stopping a search, and that after every
+		search the tree was within the budget, root included. Run with both
+		searches.
+
+	Position cache:
+		stores a confident move for a board and looks it up again, in a new
+		cache file, and checks that a confident move the board cannot make
+		is looked up as a miss rather than played.
+*/
+
+#include "mcts.h"
+#include <iostream>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+//iterations grown before moving on, and the iteration limit searched after
+#define TEST_GROW_ITERATIONS 20000
+#define TEST_ITERATIONS 200
+#define TEST_CHECKPOINT "tests.ckpt"
+#define TEST_CACHE "tests.pos"
+//batch sizes run through both rollout kernels, and the walks' steps
+#define TEST_BATCH_SIZES {1, 5, 16, 63, MAX_BATCH}
+#define TEST_BATCH_STEPS 200
+//nodes the trees may hold, and the iterations searched per move under it
+#define TEST_BUDGET 1000
+#define TEST_BUDGET_ITERATIONS 5000
+#define TEST_BUDGET_MOVES 4
+#define TEST_CACHE_ENTRIES 1024
+//replicas searched, and moves played, when checking replays across threads
+#define TEST_REPLICAS 4
+#define TEST_REPLAY_MOVES 12
+
+int failures = 0;
+
+void check(const char* name, bool passed){
+	cout<<(passed ? "PASS " : "FAIL ")<<name<<endl;
+	if(!passed)	failures++;
+}
+
+//how far the most visited root child is ahead of the runner up
+int root_gap(tree_search<fifteen_puzzle>& search){
+	int first = 0;
+	int second = 0;
+	for(int i = 0; i < 4; i++){
+		int v = search.child_visits(i);
+		if(v > first){
+			second = first;
+			first = v;
+		}
+		else if(v > second)	second = v;
+	}
+	return first - second;
+}
+
+void test_early_stop_kept_subtree(const char* mode){
+	int tiles[16] = {5, 1, 2, 3, 9, 6, 7, 4, 13, 10, 11, 8, 0, 14, 15, 12};
+	fifteen_puzzle board(tiles);
+	search_options options;
+	options.mode = mode;
+	tree_search<fifteen_puzzle>* search = make_search(options, 1, board);
+	search_limits grow;
+	grow.iterations = TEST_GROW_ITERATIONS;
+	search->search(grow);
+	int index = search->pick_child();
+	board = board.after(index);
+	bool kept = search->reroot(board);
+	int gap = root_gap(*search);
+	search_limits limits;
+	limits.iterations = TEST_ITERATIONS;
+	limits.early_stop = true;
+	search_report report = search->search(limits);
+	cout<<mode<<": kept gap "<<gap<<", "<<report.iterations<<" iterations, stopped by "
+	    <<report.stop<<endl;
+	check("kept subtree leads by more than the iterations", kept && gap > TEST_ITERATIONS);
+	check("early stop waits for this search's own visits",
+	      report.iterations >= EARLY_STOP_ITERATIONS);
+	delete search;
+}
+
+//the whole of a file, empty if it could not be read
+vector<char> read_file(const char* path){
+	vector<char> bytes;
+	FILE* in = fopen(path, "rb");
+	if(in == NULL)	return bytes;
+	char buffer[4096];
+	size_t n;
+	while((n = fread(buffer, 1, sizeof(buffer), in)) > 0)	bytes.insert(bytes.end(), buffer, buffer + n);
+	fclose(in);
+	return bytes;
+}
+bool write_file(const char* path, const vector<char>& bytes){
+	FILE* out = fopen(path, "wb");
+	if(out == NULL)	return false;
+	bool written = fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+	return fclose(out) == 0 && written;
+}
+
+//loads the checkpoint at path into a new search from board, returning the
+//loader's error and the nodes loaded
+template <class P>
+const char* load_checkpoint(const char* path, const P& board, const char* mode, size_t& loaded){
+	checkpoint_file file;
+	const char* error = file.load(path);
+	loaded = 0;
+	if(error != NULL)	return error;
+	search_options options;
+	options.mode = mode;
+	tree_search<P>* search = make_search(options, 1, board);
+	error = search->load(file, board, loaded);
+	//a rejected tree leaves a fresh root, which still has to search
+	search_limits limits;
+	limits.iterations = TEST_ITERATIONS;
+	if(error != NULL && search->search(limits).iterations != TEST_ITERATIONS)
+		error = "fresh root did not search";
+	delete search;
+	return error;
+}
+
+void test_corrupt_checkpoint(const char* mode){
+	int tiles[16] = {5, 1, 2, 3, 9, 6, 7, 4, 13, 10, 11, 8, 0, 14, 15, 12};
+	fifteen_puzzle board(tiles);
+	search_options options;
+	options.mode = mode;
+	tree_search<fifteen_puzzle>* search = make_search(options, 1, board);
+	search_limits limits;
+	limits.iterations = TEST_GROW_ITERATIONS;
+	search->search(limits);
+	bool saved = search->save(TEST_CHECKPOINT) == NULL;
+	delete search;
+	vector<char> bytes = read_file(TEST_CHECKPOINT);
+	size_t loaded;
+	const char* error = load_checkpoint(TEST_CHECKPOINT, board, mode, loaded);
+	check("checkpoint loads back whole", saved && error == NULL && loaded > 1);
+
+	//the root is the first record of the first tree and its children the next
+	//four, the first valid move's being the first with a board
+	checkpoint_node* records = (checkpoint_node*)(bytes.data() + sizeof(checkpoint_header));
+	int child = 1;
+	while(child < 5 && records[child].board_low == 0)	child++;
+	checkpoint_node original = records[child];
+	//tiles past the last cell, and two blanks
+	records[child].board_low = 0xFFFFFFFF00000000ULL;
+	error = write_file(TEST_CHECKPOINT, bytes) ? load_checkpoint(TEST_CHECKPOINT, board, mode, loaded)
+						     : NULL;
+	check("checkpoint with bad tiles is rejected", error != NULL && loaded == 0
+	      && strcmp(error, "fresh root did not search") != 0);
+	//a real board, but not the one the move leads to
+	records[child] = original;
+	records[child].board_low = board.packed();
+	error = write_file(TEST_CHECKPOINT, bytes) ? load_checkpoint(TEST_CHECKPOINT, board, mode, loaded)
+						     : NULL;
+	check("checkpoint with a misplaced board is rejected", error != NULL && loaded == 0
+	      && strcmp(error, "fresh root did not search") != 0);
+	remove(TEST_CHECKPOINT);
+}
+
+void test_philox_known_answers(){
+	//key, counter, and the hash Random123 gives for them
+	const uint32_t vectors[3][6] = {
+		{0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000},
+		{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+		{0xa4093822, 0x299f31d0, 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+	};
+	const uint32_t answers[3][4] = {
+		{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+		{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+		{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1},
+	};
+	bool passed = true;
+	for(int v = 0; v < 3; v++){
+		philox generator;
+		generator.set_key(vectors[v][0], vectors[v][1]);
+		uint32_t c[4] = {vectors[v][2], vectors[v][3], vectors[v][4], vectors[v][5]};
+		generator.hash(c);
+		for(int i = 0; i < 4; i++)	if(c[i] != answers[v][i])	passed = false;
+	}
+	check("philox matches the Random123 known answers", passed);
+}
+
+//plays moves with replicas on the given number of threads, returning every
+//move's merged root visits followed by the move chosen
+vector<int> replay(int threads){
+	int tiles[16] = {5, 1, 2, 3, 9, 6, 7, 4, 13, 10, 11, 8, 0, 14, 15, 12};
+	fifteen_puzzle board(tiles);
+	search_options options;
+	options.threads = threads;
+	options.replicas = TEST_REPLICAS;
+	tree_search<fifteen_puzzle>* search = make_search(options, 7, board);
+	search_limits limits;
+	limits.iterations = TEST_ITERATIONS;
+	xoshiro256 environment(7);
+	vector<int> trace;
+	for(int m = 0; m < TEST_REPLAY_MOVES && !board.goal_test(); m++){
+		search->search(limits);
+		for(int i = 0; i < 4; i++)	trace.push_back(search->child_visits(i));
+		char move = search->pick_move();
+		trace.push_back(move);
+		board.swap(move, environment);
+		search->reroot(board);
+	}
+	delete search;
+	return trace;
+}
+
+void test_replicas_across_threads(){
+	vector<int> one = replay(1);
+	check("replicas replay the same on two threads", replay(2) == one);
+	check("replicas replay the same on four threads", replay(4) == one);
+}
+
+void test_rollout_kernels(){
+	if(!rollout_batch::has_avx2()){
+		cout<<"no AVX2, skipping the kernel comparison"<<endl;
+		return;
+	}
+	int tiles[3][16] = {
+		{5, 1, 2, 3, 9, 6, 7, 4, 13, 10, 11, 8, 0, 14, 15, 12},
+		{13, 8, 0, 5, 1, 15, 3, 11, 6, 12, 9, 4, 7, 10, 2, 14},
+		//one move from the goal, so that walks score goals as well
+		{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0, 15},
+	};
+	const int sizes[] = TEST_BATCH_SIZES;
+	bool passed = true;
+	rollout_batch batch;
+	for(int b = 0; b < 3; b++){
+		fifteen_puzzle board(tiles[b]);
+		for(int size : sizes){
+			xoshiro256 vector_rng(b + 1);
+			xoshiro256 scalar_rng(b + 1);
+			rollout_stats v = batch.walk(TEST_BATCH_STEPS, board, size, vector_rng, true);
+			rollout_stats s = batch.walk(TEST_BATCH_STEPS, board, size, scalar_rng, false);
+			if(v.mean != s.mean || v.variance != s.variance)	passed = false;
+		}
+	}
+	check("AVX2 and scalar rollout kernels agree", passed);
+}
+
+void test_node_budget(const char* mode){
+	int tiles[16] = {5, 1, 2, 3, 9, 6, 7, 4, 13, 10, 11, 8, 0, 14, 15, 12};
+	fifteen_puzzle board(tiles);
+	search_options options;
+	options.mode = mode;
+	options.node_budget = TEST_BUDGET;
+	tree_search<fifteen_puzzle>* search = make_search(options, 1, board);
+	search_limits limits;
+	limits.iterations = TEST_BUDGET_ITERATIONS;
+	xoshiro256 environment(1);
+	long long evicted = 0;
+	bool stopped = false;
+	int largest = 0;
+	for(int m = 0; m < TEST_BUDGET_MOVES && !board.goal_test(); m++){
+		search_report report = search->search(limits);
+		evicted += report.evicted;
+		if(strcmp(report.stop, "budget") == 0)	stopped = true;
+		if(search->size() > largest)	largest = search->size();
+		board.swap(search->pick_move(), environment);
+		search->reroot(board);
+	}
+	cout<<mode<<": "<<evicted<<" nodes evicted, at most "<<largest<<" nodes held"<<endl;
+	check("node budget was reached", evicted > 0 || stopped);
+	check("tree stays within the node budget", largest <= TEST_BUDGET + 1);
+	delete search;
+}
+
+void test_position_cache(){
+	remove(TEST_CACHE);
+	position_cache cache;
+	bool loaded = cache.load(TEST_CACHE, TEST_CACHE_ENTRIES) == NULL;
+	//the blank is in the bottom left corner, so up and right are the only moves
+	int tiles[16] = {5, 1, 2, 3, 9, 6, 7, 4, 13, 10, 11, 8, 0, 14, 15, 12};
+	fifteen_puzzle board(tiles);
+	cache.store(board, 3, CACHE_MIN_VISITS * 2, 0.9);
+	check("cached move is looked up again", loaded && cache.lookup(board) == 3);
+	//the blank is in the top left corner, so up cannot be played
+	int corner[16] = {0, 1, 2, 3, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12};
+	fifteen_puzzle cornered(corner);
+	cache.store(cornered, 0, CACHE_MIN_VISITS * 2, 0.9);
+	check("cached move the board cannot make is a miss", loaded && cache.lookup(cornered) == -1);
+	remove(TEST_CACHE);
+}
+
+int main(){
+	test_early_stop_kept_subtree("root");
+	test_early_stop_kept_subtree("tree");
+	test_corrupt_checkpoint("root");
+	test_corrupt_checkpoint("tree");
+	test_philox_known_answers();
+	test_replicas_across_threads();
+	test_rollout_kernels();
+	test_node_budget("root");
+	test_node_budget("tree");
+	test_position_cache();
+	return failures == 0 ? 0 : 1;
+}